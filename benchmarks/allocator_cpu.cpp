@@ -0,0 +1,327 @@
+#include "cpu_bench.hpp"
+#include "mock_resource.hpp"
+#include "vuk/Descriptor.hpp"
+#include "vuk/resources/DeviceFrameResource.hpp"
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/* CPU cost of caches and allocator bookkeeping
+ * Name interning and descriptor pool churn need no device - the descriptor pool is seeded with handles fabricated by a mock DeviceResource.
+ * With --device, a headless Vulkan device is created (lavapipe works): the descriptor pool is then the one the Context holds for a set layout, and
+ * the bookkeeping of DeviceSuperFrameResource and DeviceFrameResource and the Context caches is measured as well. These are built on a Context, so
+ * they can't run against the mock.
+ * Every case is run on 1, 2, 4 ... up to --threads threads, reporting the time per operation and the aggregate throughput.
+ */
+
+namespace {
+	// runs fn(thread_index) on n_threads threads at once and returns the wall time spent
+	template<class F>
+	double run_threads(unsigned n_threads, F&& fn) {
+		std::atomic<bool> go = false;
+		std::atomic<unsigned> ready = 0;
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < n_threads; t++) {
+			threads.emplace_back([&, t] {
+				ready.fetch_add(1);
+				while (!go.load()) {
+					std::this_thread::yield();
+				}
+				fn(t);
+			});
+		}
+		while (ready.load() < n_threads) {
+			std::this_thread::yield();
+		}
+		auto start = std::chrono::steady_clock::now();
+		go.store(true);
+		for (auto& t : threads) {
+			t.join();
+		}
+		return util::seconds_since(start);
+	}
+
+	constexpr unsigned intern_ops = 100000;
+	constexpr unsigned intern_set_size = 256;
+
+	// names that are already interned: a hash and a lookup under a shared lock
+	double intern_hit(unsigned n_threads, const std::vector<std::string>& strings) {
+		return run_threads(n_threads, [&](unsigned) {
+			for (unsigned i = 0; i < intern_ops; i++) {
+				vuk::Name n{ std::string_view(strings[i % strings.size()]) };
+				(void)n;
+			}
+		});
+	}
+
+	constexpr unsigned intern_miss_ops = 2000;
+
+	// names never seen before: the string is copied into the intern buffers under an exclusive lock
+	// interned strings are never freed, so every run grows the intern buffers
+	double intern_miss(unsigned n_threads, unsigned run) {
+		return run_threads(n_threads, [&](unsigned t) {
+			std::string s = "miss_" + std::to_string(run) + "_" + std::to_string(t) + "_";
+			auto prefix_size = s.size();
+			for (unsigned i = 0; i < intern_miss_ops; i++) {
+				s.resize(prefix_size);
+				s += std::to_string(i);
+				vuk::Name n{ std::string_view(s) };
+				(void)n;
+			}
+		});
+	}
+
+	constexpr unsigned churn_frames = 200;
+	constexpr unsigned churn_batch = 16;
+	// objects allocated per thread and frame: semaphores, command buffers, buffers, images and image views
+	constexpr unsigned churn_ops_per_frame = churn_batch * 5;
+
+	// allocations of a frame's worth of objects from frames of the super frame resource, released when the frame is recycled
+	// frames are never submitted, so recycling them does not wait - the time is spent in the deferred queues and the pools of recycled objects
+	double frame_churn(unsigned n_threads, util::HeadlessDevice& device) {
+		auto& ctx = *device.context;
+		auto& sfr = *device.sfr;
+		vuk::DeviceFrameResource* frame = nullptr;
+		// once every thread is done with the current frame, a single thread recycles the next frame while the others wait for it
+		std::barrier next_frame(n_threads, [&]() noexcept {
+			frame = &sfr.get_next_frame();
+			ctx.next_frame();
+		});
+
+		return run_threads(n_threads, [&](unsigned) {
+			std::array<VkSemaphore, churn_batch> semaphores;
+			std::array<vuk::CommandBufferAllocation, churn_batch> command_buffers;
+			std::array<vuk::BufferCrossDevice, churn_batch> buffers;
+			std::array<vuk::Image, churn_batch> images;
+			std::array<vuk::ImageView, churn_batch> image_views;
+
+			VkCommandPoolCreateInfo cpci{ .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, .queueFamilyIndex = ctx.graphics_queue_family_index };
+			std::array<vuk::BufferCreateInfo, churn_batch> bcis;
+			bcis.fill({ .mem_usage = vuk::MemoryUsage::eCPUtoGPU, .size = 1024 });
+			std::array<vuk::ImageCreateInfo, churn_batch> icis;
+			icis.fill({ .format = vuk::Format::eR8G8B8A8Unorm,
+			            .extent = { .width = 256, .height = 256, .depth = 1 },
+			            .usage = vuk::ImageUsageFlagBits::eSampled | vuk::ImageUsageFlagBits::eTransferDst });
+			std::array<vuk::ImageViewCreateInfo, churn_batch> ivcis;
+			std::array<vuk::CommandBufferAllocationCreateInfo, churn_batch> cbcis;
+
+			for (unsigned f = 0; f < churn_frames; f++) {
+				next_frame.arrive_and_wait();
+				vuk::CommandPool pool{};
+				(void)frame->allocate_command_pools(std::span{ &pool, 1 }, std::span{ &cpci, 1 }, VUK_HERE_AND_NOW());
+				cbcis.fill({ .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY, .command_pool = pool });
+				(void)frame->allocate_semaphores(semaphores, VUK_HERE_AND_NOW());
+				(void)frame->allocate_command_buffers(command_buffers, cbcis, VUK_HERE_AND_NOW());
+				(void)frame->allocate_buffers(std::span<vuk::BufferCrossDevice>(buffers), bcis, VUK_HERE_AND_NOW());
+				(void)frame->allocate_images(images, icis, VUK_HERE_AND_NOW());
+				for (unsigned i = 0; i < churn_batch; i++) {
+					ivcis[i] = { .image = images[i], .format = vuk::Format::eR8G8B8A8Unorm, .subresourceRange = { .aspectMask = vuk::ImageAspectFlagBits::eColor } };
+				}
+				(void)frame->allocate_image_views(image_views, ivcis, VUK_HERE_AND_NOW());
+			}
+		});
+	}
+
+	constexpr unsigned pool_ops = 20000;
+	constexpr unsigned pool_batch = 8;
+
+	// descriptor sets acquired from and released to a descriptor pool, as done when allocating and recycling descriptor sets
+	double descriptor_pool_churn(unsigned n_threads, vuk::DescriptorPool& pool, VkDevice device, const vuk::DescriptorSetLayoutAllocInfo& dslai) {
+		return run_threads(n_threads, [&](unsigned) {
+			std::array<VkDescriptorSet, pool_batch> sets;
+			for (unsigned i = 0; i < pool_ops / pool_batch; i++) {
+				pool.acquire(device, dslai, sets);
+				pool.release(sets);
+			}
+		});
+	}
+
+	// a thread holds at most two batches of its cache and the sets it acquired, so this many sets per thread never make the pool grow
+	constexpr unsigned mock_pool_sets_per_thread = 256;
+
+	// the same churn on a pool that only hands out sets fabricated by the mock - growing the pool would need a device
+	double mock_descriptor_pool_churn(unsigned n_threads, util::DeviceMockResource& mock) {
+		vuk::DescriptorPool pool;
+		std::vector<VkDescriptorSet> seed(n_threads * mock_pool_sets_per_thread);
+		for (auto& ds : seed) {
+			ds = mock.fabricate<VkDescriptorSet>();
+		}
+		pool.release(seed);
+		auto time = descriptor_pool_churn(n_threads, pool, VK_NULL_HANDLE, {});
+		// never grown, so there are no Vulkan pools to destroy
+		pool.destroy(VK_NULL_HANDLE);
+		return time;
+	}
+
+	const char* descriptor_pool_shader = R"(#version 450
+#pragma shader_stage(compute)
+
+layout(local_size_x = 1) in;
+
+layout(set = 0, binding = 0) buffer Data {
+	uint data[];
+};
+
+void main() {
+	data[gl_GlobalInvocationID.x] = 0;
+}
+)";
+
+	constexpr unsigned acquire_ops = 20000;
+	constexpr unsigned sampler_set_size = 64;
+
+	// cache hits in the sampler cache of the Context
+	double sampler_acquire(unsigned n_threads, vuk::Context& ctx, const std::vector<vuk::SamplerCreateInfo>& scis) {
+		auto frame = ctx.get_frame_count();
+		return run_threads(n_threads, [&](unsigned t) {
+			for (unsigned i = 0; i < acquire_ops; i++) {
+				auto sampler = ctx.acquire_sampler(scis[(i + t) % scis.size()], frame);
+				(void)sampler;
+			}
+		});
+	}
+
+	struct Result {
+		std::string_view bench;
+		unsigned threads;
+		util::Statistics statistics; // seconds per operation
+		size_t runs;
+	};
+
+	void print_result(const Result& r, bool json, bool first) {
+		auto& st = r.statistics;
+		// aggregate throughput of all threads, in millions of operations per second
+		auto mops = r.threads / st.mean * 1e-6;
+		if (json) {
+			printf("%s\n\t\t{ \"case\": \"%s\", \"threads\": %u, \"runs\": %zu, \"mean_ns_per_op\": %f, \"variance_ns2\": %f, \"min_ns_per_op\": %f, "
+			       "\"max_ns_per_op\": %f, \"mops\": %f }",
+			       first ? "" : ",",
+			       r.bench.data(),
+			       r.threads,
+			       r.runs,
+			       st.mean * 1e9,
+			       st.variance * 1e18,
+			       st.min * 1e9,
+			       st.max * 1e9,
+			       mops);
+		} else {
+			printf("%-16s %3u threads: mu=%f ns/op, sigma=%f ns2, min=%f ns/op, max=%f ns/op, %f Mops/s, runs: %zu\n",
+			       r.bench.data(),
+			       r.threads,
+			       st.mean * 1e9,
+			       st.variance * 1e18,
+			       st.min * 1e9,
+			       st.max * 1e9,
+			       mops,
+			       r.runs);
+		}
+	}
+} // namespace
+
+// usage: vuk_bench_allocator_cpu [--device] [--runs N] [--threads N] [--json]
+int main(int argc, char** argv) {
+	bool use_device = false;
+	bool json = false;
+	unsigned runs = 20;
+	unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg == "--device") {
+			use_device = true;
+		} else if (arg == "--json") {
+			json = true;
+		} else if (arg == "--runs" && i + 1 < argc) {
+			runs = (unsigned)std::max(1, atoi(argv[++i]));
+		} else if (arg == "--threads" && i + 1 < argc) {
+			max_threads = (unsigned)std::max(1, atoi(argv[++i]));
+		} else {
+			fprintf(stderr, "usage: %s [--device] [--runs N] [--threads N] [--json]\n", argv[0]);
+			return 1;
+		}
+	}
+	std::vector<unsigned> thread_counts;
+	for (unsigned t = 1; t < max_threads; t *= 2) {
+		thread_counts.push_back(t);
+	}
+	thread_counts.push_back(max_threads);
+
+	util::DeviceMockResource mock;
+	std::optional<util::HeadlessDevice> device;
+	if (use_device) {
+		device.emplace();
+		if (!device->init("vuk_bench_allocator_cpu")) {
+			fprintf(stderr, "could not create a Vulkan device, only the cases that need no device will be measured\n");
+			device.reset();
+		}
+	}
+	vuk::DescriptorSetLayoutAllocInfo dslai;
+	if (device) {
+		vuk::PipelineBaseCreateInfo pci;
+		pci.add_glsl(descriptor_pool_shader, "descriptor_pool.comp");
+		device->context->create_named_pipeline("descriptor_pool", pci);
+		dslai = device->context->get_named_pipeline("descriptor_pool")->layout_info[0];
+	}
+
+	std::vector<std::string> intern_strings;
+	for (unsigned i = 0; i < intern_set_size; i++) {
+		intern_strings.push_back("intern_" + std::to_string(i));
+		vuk::Name n{ std::string_view(intern_strings.back()) };
+	}
+	std::vector<vuk::SamplerCreateInfo> scis;
+	for (unsigned i = 0; i < sampler_set_size; i++) {
+		scis.push_back({ .magFilter = vuk::Filter::eLinear, .minFilter = vuk::Filter::eLinear, .maxLod = (float)i });
+	}
+
+	std::vector<Result> results;
+	std::vector<double> timings;
+	auto measure = [&](std::string_view bench, unsigned n_threads, unsigned ops_per_thread, auto&& fn) {
+		timings.clear();
+		for (unsigned run = 0; run < runs; run++) {
+			// time per operation, as seen by a single thread
+			timings.push_back(fn(run) / ops_per_thread);
+		}
+		results.push_back({ bench, n_threads, util::compute_statistics(timings), timings.size() });
+	};
+
+	for (auto n_threads : thread_counts) {
+		measure("intern hit", n_threads, intern_ops, [&](unsigned) { return intern_hit(n_threads, intern_strings); });
+		measure("intern miss", n_threads, intern_miss_ops, [&](unsigned run) { return intern_miss(n_threads, run * (max_threads + 1) + n_threads); });
+		if (device) {
+			auto& ctx = *device->context;
+			auto& pool = ctx.acquire_descriptor_pool(dslai, ctx.get_frame_count());
+			measure("descriptor pool", n_threads, pool_ops * 2, [&](unsigned) { return descriptor_pool_churn(n_threads, pool, ctx.device, dslai); });
+		} else {
+			measure("descriptor pool", n_threads, pool_ops * 2, [&](unsigned) { return mock_descriptor_pool_churn(n_threads, mock); });
+		}
+		if (device) {
+			measure("frame churn", n_threads, churn_frames * churn_ops_per_frame, [&](unsigned) { return frame_churn(n_threads, *device); });
+			measure("sampler acquire", n_threads, acquire_ops, [&](unsigned) { return sampler_acquire(n_threads, *device->context, scis); });
+		}
+	}
+
+	// collecting the Context caches is single threaded: it scans every cache for entries that have not been used recently
+	if (device) {
+		timings.clear();
+		for (unsigned run = 0; run < runs; run++) {
+			device->context->next_frame();
+			auto start = std::chrono::steady_clock::now();
+			device->context->collect(device->context->get_frame_count());
+			timings.push_back(util::seconds_since(start));
+		}
+		results.push_back({ "context collect", 1, util::compute_statistics(timings), timings.size() });
+	}
+
+	if (json) {
+		printf("{\n\t\"bench\": \"allocator_cpu\",\n\t\"results\": [");
+	}
+	for (size_t i = 0; i < results.size(); i++) {
+		print_result(results[i], json, i == 0);
+	}
+	if (json) {
+		printf("\n\t]\n}\n");
+	}
+}
@@ -1,9 +1,11 @@
 #include "bench_runner.hpp"
 #include "../src/RenderGraphUtil.hpp"
+#include <stdlib.h>
 
 std::vector<std::string> chosen_resource;
 
-vuk::BenchRunner::BenchRunner() {
+void vuk::BenchRunner::init(bool headless) {
+	this->headless = headless;
 	vkb::InstanceBuilder builder;
 	builder
 	    .set_debug_callback([](VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -18,7 +20,8 @@ vuk::BenchRunner::BenchRunner() {
 	    .set_app_name("vuk_bench")
 	    .set_engine_name("vuk")
 	    .require_api_version(1, 2, 0)
-	    .set_app_version(0, 1, 0);
+	    .set_app_version(0, 1, 0)
+	    .set_headless(headless);
 	auto inst_ret = builder.build();
 	if (!inst_ret.has_value()) {
 		// error
@@ -26,9 +29,14 @@ vuk::BenchRunner::BenchRunner() {
 	vkbinstance = inst_ret.value();
 	auto instance = vkbinstance.instance;
 	vkb::PhysicalDeviceSelector selector{ vkbinstance };
-	window = create_window_glfw("vuk-benchmarker", false);
-	surface = create_surface_glfw(vkbinstance.instance, window);
-	selector.set_surface(surface).set_minimum_version(1, 0).add_required_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+	if (headless) {
+		selector.require_present(false);
+	} else {
+		window = create_window_glfw("vuk-benchmarker", false);
+		surface = create_surface_glfw(vkbinstance.instance, window);
+		selector.set_surface(surface);
+	}
+	selector.set_minimum_version(1, 0).add_required_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
 	auto phys_ret = selector.select();
 	if (!phys_ret.has_value()) {
 		// error
@@ -59,7 +67,9 @@ vuk::BenchRunner::BenchRunner() {
 	const unsigned num_inflight_frames = 3;
 	xdev_rf_alloc.emplace(*context, num_inflight_frames);
 	global.emplace(*xdev_rf_alloc);
-	swapchain = context->add_swapchain(util::make_swapchain(vkbdevice));
+	if (!headless) {
+		swapchain = context->add_swapchain(util::make_swapchain(vkbdevice));
+	}
 }
 
 constexpr unsigned stage_wait = 0;
@@ -68,6 +78,38 @@ constexpr unsigned stage_variance = 2;
 constexpr unsigned stage_live = 3;
 constexpr unsigned stage_complete = 4;
 
+// compute mean, variance, extrema and histogram from the timings of a subcase
+static void compute_results(vuk::CaseBase& bcase, unsigned subcase) {
+	auto& timings = bcase.timings[subcase];
+	auto num_runs = timings.size();
+
+	double& mean = bcase.mean[subcase];
+	mean = 0;
+	double& min = bcase.min_max[subcase].first;
+	min = DBL_MAX;
+	double& max = bcase.min_max[subcase].second;
+	max = 0;
+	for (auto& t : timings) {
+		mean += t;
+		min = std::min(min, t);
+		max = std::max(max, t);
+	}
+	mean /= num_runs;
+
+	auto& bins = bcase.binned[subcase];
+	bins.clear();
+	bins.resize(64);
+
+	double& variance = bcase.variance[subcase];
+	variance = 0;
+	for (auto& t : timings) {
+		variance += (t - mean) * (t - mean);
+		auto bin_index = max > min ? (uint32_t)std::floor((bins.size() - 1) * (t - min) / (max - min)) : 0;
+		bins[bin_index]++;
+	}
+	variance *= num_runs > 1 ? 1.0 / (num_runs - 1) : 0.0;
+}
+
 void vuk::BenchRunner::render() {
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
@@ -209,30 +251,7 @@ void vuk::BenchRunner::render() {
 			bcase.last_stage_ran[current_subcase]++;
 			// reuse timings for subsequent live
 		} else if (current_stage == stage_live && num_runs >= bcase.runs_required[current_subcase]) {
-			double& mean = bcase.mean[current_subcase];
-			mean = 0;
-			double& min = bcase.min_max[current_subcase].first;
-			min = DBL_MAX;
-			double& max = bcase.min_max[current_subcase].second;
-			max = 0;
-			for (auto& t : bcase.timings[current_subcase]) {
-				mean += t;
-				min = std::min(min, t);
-				max = std::max(max, t);
-			}
-			mean /= num_runs;
-
-			auto& bins = bcase.binned[current_subcase];
-			bins.resize(64);
-
-			double& variance = bcase.variance[current_subcase];
-			variance = 0;
-			for (auto& t : bcase.timings[current_subcase]) {
-				variance += (t - mean) * (t - mean);
-				auto bin_index = (uint32_t)std::floor((bins.size() - 1) * (t - min) / (max - min));
-				bins[bin_index]++;
-			}
-			variance *= 1.0 / (num_runs - 1);
+			compute_results(bcase, current_subcase);
 
 			bcase.last_stage_ran[current_subcase]++;
 
@@ -258,8 +277,120 @@ void vuk::BenchRunner::render() {
 	}
 }
 
-int main() {
-	vuk::BenchRunner::get_runner().setup();
-	vuk::BenchRunner::get_runner().render();
-	vuk::BenchRunner::get_runner().cleanup();
+void vuk::BenchRunner::render_headless(unsigned warmup_runs, unsigned runs) {
+	for (current_case = 0; current_case < bench->num_cases; current_case++) {
+		auto& bcase = bench->get_case(current_case);
+		for (current_subcase = 0; current_subcase < bcase.subcases.size(); current_subcase++) {
+			auto& timings = bcase.timings[current_subcase];
+			timings.clear();
+			unsigned results = 0;
+			// timestamps become available only once the frame is recycled, so results lag behind submissions
+			// give up on subcases that don't produce timestamps instead of spinning forever
+			const unsigned max_submissions = 2 * (warmup_runs + runs) + 16;
+			for (unsigned submissions = 0; timings.size() < runs && submissions < max_submissions; submissions++) {
+				auto& xdev_frame_resource = xdev_rf_alloc->get_next_frame();
+				context->next_frame();
+				Allocator frame_allocator(xdev_frame_resource);
+				auto rg = bcase.subcases[current_subcase](*this, frame_allocator, start, end);
+				rg.attach_managed(
+				    "_final", vuk::Format::eR8G8B8A8Srgb, vuk::Dimension2D::absolute(1024, 1024), vuk::Samples::e1, vuk::ClearColor{ 0.3f, 0.5f, 0.3f, 1.0f });
+				execute_submit_and_wait(frame_allocator, std::move(rg).link(*context, vuk::RenderGraph::CompileOptions{}));
+
+				std::optional<double> duration = context->retrieve_duration(start, end);
+				if (duration && results++ >= warmup_runs) {
+					timings.push_back(*duration);
+				}
+			}
+			bcase.runs_required[current_subcase] = (uint32_t)timings.size();
+			if (timings.size() > 0) {
+				compute_results(bcase, current_subcase);
+				bcase.last_stage_ran[current_subcase] = stage_complete;
+			} else {
+				fprintf(stderr, "%s / %s: no timestamps were produced\n", bcase.label.data(), bcase.subcase_labels[current_subcase].data());
+			}
+		}
+	}
+}
+
+void vuk::BenchRunner::print_results(bool json) {
+	if (json) {
+		printf("{\n\t\"bench\": \"%s\",\n\t\"results\": [", bench->name.data());
+	} else {
+		printf("%s\n", bench->name.data());
+	}
+	bool first = true;
+	for (auto i = 0; i < bench->num_cases; i++) {
+		auto& bcase = bench->get_case(i);
+		for (auto j = 0; j < bcase.subcases.size(); j++) {
+			if (bcase.last_stage_ran[j] != stage_complete) {
+				continue;
+			}
+			auto runs = bcase.runs_required[j];
+			auto mean = bcase.mean[j] * 1e6;
+			auto variance = bcase.variance[j] * 1e12;
+			auto sem = sqrt(variance / runs);
+			auto [min, max] = bcase.min_max[j];
+			if (json) {
+				printf("%s\n\t\t{ \"case\": \"%s\", \"subcase\": \"%s\", \"runs\": %u, \"mean_us\": %f, \"variance_us2\": %f, \"sem_us\": %f, \"min_us\": %f, "
+				       "\"max_us\": %f }",
+				       first ? "" : ",",
+				       bcase.label.data(),
+				       bcase.subcase_labels[j].data(),
+				       runs,
+				       mean,
+				       variance,
+				       sem,
+				       min * 1e6,
+				       max * 1e6);
+			} else {
+				printf("%s / %s: mu=%f us, sigma=%f us2, SEM = %f us, min=%f us, max=%f us, runs: %u\n",
+				       bcase.label.data(),
+				       bcase.subcase_labels[j].data(),
+				       mean,
+				       variance,
+				       sem,
+				       min * 1e6,
+				       max * 1e6,
+				       runs);
+			}
+			first = false;
+		}
+	}
+	if (json) {
+		printf("\n\t]\n}\n");
+	}
+}
+
+// usage: vuk_bench_<name> [--headless] [--runs N] [--warmup N] [--json]
+int main(int argc, char** argv) {
+	bool headless = false;
+	bool json = false;
+	unsigned runs = 128;
+	unsigned warmup_runs = 50;
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg == "--headless") {
+			headless = true;
+		} else if (arg == "--json") {
+			json = true;
+		} else if (arg == "--runs" && i + 1 < argc) {
+			runs = (unsigned)std::max(1, atoi(argv[++i]));
+		} else if (arg == "--warmup" && i + 1 < argc) {
+			warmup_runs = (unsigned)std::max(0, atoi(argv[++i]));
+		} else {
+			fprintf(stderr, "usage: %s [--headless] [--runs N] [--warmup N] [--json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	auto& runner = vuk::BenchRunner::get_runner();
+	runner.init(headless);
+	runner.setup();
+	if (headless) {
+		runner.render_headless(warmup_runs, runs);
+		runner.print_results(json);
+	} else {
+		runner.render();
+	}
+	runner.cleanup();
 }
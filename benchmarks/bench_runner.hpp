@@ -87,8 +87,10 @@ namespace vuk {
 		std::optional<DeviceSuperFrameResource> xdev_rf_alloc;
 		std::optional<Allocator> global;
 		vuk::SwapchainRef swapchain;
-		GLFWwindow* window;
-		VkSurfaceKHR surface;
+		// when running headless, no window, surface or swapchain is created and cases render into offscreen images
+		bool headless = false;
+		GLFWwindow* window = nullptr;
+		VkSurfaceKHR surface = VK_NULL_HANDLE;
 		vkb::Instance vkbinstance;
 		vkb::Device vkbdevice;
 		util::ImGuiData imgui_data;
@@ -103,9 +105,18 @@ namespace vuk {
 
 		BenchBase* bench;
 
-		BenchRunner();
+		BenchRunner() = default;
+
+		/// @brief Create the device (and the window, unless headless)
+		void init(bool headless);
 
 		void setup() {
+			start = context->create_timestamp_query();
+			end = context->create_timestamp_query();
+			if (headless) {
+				bench->setup(*this, *global);
+				return;
+			}
 			// Setup Dear ImGui context
 			IMGUI_CHECKVERSION();
 			ImGui::CreateContext();
@@ -114,14 +125,21 @@ namespace vuk {
 			// Setup Platform/Renderer bindings
 			ImGui_ImplGlfw_InitForVulkan(window, true);
 
-			start = context->create_timestamp_query();
-			end = context->create_timestamp_query();
 			{ imgui_data = util::ImGui_ImplVuk_Init(*global); }
 			bench->setup(*this, *global);
 		}
 
 		void render();
 
+		/// @brief Run every subcase for a fixed number of timed runs, without any window or GUI
+		/// @param warmup_runs runs discarded before sampling
+		/// @param runs number of timed runs per subcase
+		void render_headless(unsigned warmup_runs, unsigned runs);
+
+		/// @brief Print the results of all subcases that have completed
+		/// @param json print a JSON document instead of human-readable text
+		void print_results(bool json);
+
 		void cleanup() {
 			context->wait_idle();
 			if (bench->cleanup) {
@@ -130,12 +148,17 @@ namespace vuk {
 		}
 
 		~BenchRunner() {
+			if (!context) {
+				return;
+			}
 			imgui_data.font_texture.view.reset();
 			imgui_data.font_texture.image.reset();
 			xdev_rf_alloc.reset();
 			context.reset();
-			vkDestroySurfaceKHR(vkbinstance.instance, surface, nullptr);
-			destroy_window_glfw(window);
+			if (!headless) {
+				vkDestroySurfaceKHR(vkbinstance.instance, surface, nullptr);
+				destroy_window_glfw(window);
+			}
 			vkb::destroy_device(vkbdevice);
 			vkb::destroy_instance(vkbinstance);
 		}
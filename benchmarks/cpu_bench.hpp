@@ -0,0 +1,99 @@
+#pragma once
+
+#include "vuk/AllocatorHelpers.hpp"
+#include "vuk/Context.hpp"
+#include "vuk/RenderGraph.hpp"
+#include "vuk/resources/DeviceFrameResource.hpp"
+#include <VkBootstrap.h>
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <stdio.h>
+#include <vector>
+
+// shared helpers of the CPU benchmarks, which run without a window or the GUI runner
+namespace util {
+	struct Statistics {
+		double mean = 0;
+		double variance = 0;
+		double min = 0;
+		double max = 0;
+	};
+
+	inline Statistics compute_statistics(const std::vector<double>& timings) {
+		Statistics s{ .min = timings[0], .max = timings[0] };
+		for (auto& t : timings) {
+			s.mean += t;
+			s.min = std::min(s.min, t);
+			s.max = std::max(s.max, t);
+		}
+		s.mean /= timings.size();
+		for (auto& t : timings) {
+			s.variance += (t - s.mean) * (t - s.mean);
+		}
+		s.variance *= timings.size() > 1 ? 1.0 / (timings.size() - 1) : 0.0;
+		return s;
+	}
+
+	inline double seconds_since(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/// @brief Vulkan device without any surface (lavapipe works)
+	struct HeadlessDevice {
+		vkb::Instance vkbinstance;
+		vkb::Device vkbdevice;
+		std::optional<vuk::Context> context;
+		std::optional<vuk::DeviceSuperFrameResource> sfr;
+		std::optional<vuk::Allocator> global;
+
+		bool init(const char* app_name) {
+			vkb::InstanceBuilder builder;
+			builder.set_app_name(app_name).set_engine_name("vuk").require_api_version(1, 2, 0).set_headless(true);
+			auto inst_ret = builder.build();
+			if (!inst_ret) {
+				return false;
+			}
+			vkbinstance = inst_ret.value();
+			vkb::PhysicalDeviceSelector selector{ vkbinstance };
+			selector.require_present(false).set_minimum_version(1, 0).add_required_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+			auto phys_ret = selector.select();
+			if (!phys_ret) {
+				return false;
+			}
+			vkb::DeviceBuilder device_builder{ phys_ret.value() };
+			VkPhysicalDeviceVulkan12Features vk12features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+			vk12features.timelineSemaphore = true;
+			vk12features.hostQueryReset = true;
+			VkPhysicalDeviceSynchronization2FeaturesKHR sync_feat{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+				                                                     .synchronization2 = true };
+			auto dev_ret = device_builder.add_pNext(&vk12features).add_pNext(&sync_feat).build();
+			if (!dev_ret) {
+				return false;
+			}
+			vkbdevice = dev_ret.value();
+			auto graphics_queue = vkbdevice.get_queue(vkb::QueueType::graphics).value();
+			auto graphics_queue_family_index = vkbdevice.get_queue_index(vkb::QueueType::graphics).value();
+			context.emplace(vuk::ContextCreateParameters{
+			    vkbinstance.instance, vkbdevice.device, vkbdevice.physical_device.physical_device, graphics_queue, graphics_queue_family_index });
+			sfr.emplace(*context, 3);
+			global.emplace(*sfr);
+			return true;
+		}
+
+		~HeadlessDevice() {
+			if (context) {
+				context->wait_idle();
+			}
+			global.reset();
+			sfr.reset();
+			context.reset();
+			if (vkbdevice.device) {
+				vkb::destroy_device(vkbdevice);
+			}
+			if (vkbinstance.instance) {
+				vkb::destroy_instance(vkbinstance);
+			}
+		}
+	};
+} // namespace util
@@ -1,71 +1,216 @@
-#include "bench_runner.hpp"
-
-/* 01_triangle
- * In this example we will draw a bufferless triangle, the "Hello world" of graphics programming
- * For this, we will need to define our pipeline, and then submit a draw.
- *
- * These examples are powered by the example framework, which hides some of the code required, as that would be repeated for each example.
- * Furthermore it allows launching individual examples and all examples with the example same code.
- * Check out the framework (example_runner_*) files if interested!
+#include "cpu_bench.hpp"
+#include "vuk/CommandBuffer.hpp"
+#include <array>
+#include <stdlib.h>
+#include <string_view>
+
+/* CPU overhead of draws
+ * A pass issuing many small draws is recorded, changing a single piece of state before every draw, and the CPU time spent recording the draws
+ * is divided by the number of draws. The command buffers are recorded on a headless device, but never submitted.
  */
 
 namespace {
-	struct V1 {
-		std::string_view description = "1 iter";
-		static constexpr unsigned n_iters = 1;
-	};
+	const char* vertex_shader = R"(#version 450
+#pragma shader_stage(vertex)
 
-	struct V2 {
-		std::string_view description = "100 iters";
-		static constexpr unsigned n_iters = 100;
-	};
+layout(constant_id = 0) const float scale = 1.0;
+
+layout(push_constant) uniform PushConstants {
+	vec4 offset;
+};
+
+layout(set = 0, binding = 0) uniform Color {
+	vec4 color;
+};
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+	vec2 pos = vec2((gl_VertexIndex & 1) * 2 - 1, (gl_VertexIndex >> 1) * 2 - 1) * 0.05 * scale;
+	gl_Position = vec4(pos + offset.xy, 0.0, 1.0);
+	out_color = color;
+}
+)";
+
+	const char* fragment_shader_a = R"(#version 450
+#pragma shader_stage(fragment)
+
+layout(location = 0) in vec4 in_color;
+layout(location = 0) out vec4 out_color;
+
+void main() {
+	out_color = in_color;
+}
+)";
+
+	const char* fragment_shader_b = R"(#version 450
+#pragma shader_stage(fragment)
 
-	vuk::Bench<V1, V2> x{
-		// The display name of this example
-		.base = { .name = "Dependent vs. non-dependent texture fetch",
-		          // Setup code, ran once in the beginning
-		          .setup =
-		              [](vuk::BenchRunner& runner, vuk::Allocator& frame_allocator) {
-		                // Pipelines are created by filling out a vuk::PipelineCreateInfo
-		                // In this case, we only need the shaders, we don't care about the rest of the state
-		                vuk::PipelineBaseCreateInfo pci;
-		                pci.add_glsl(util::read_entire_file("../../examples/triangle.vert"), "triangle.vert");
-		                pci.add_glsl(util::read_entire_file("../../examples/triangle.frag"), "triangle.frag");
-		                // The pipeline is stored with a user give name for simplicity
-		                runner.context->create_named_pipeline("triangle", pci);
-		              },
-		          .gui =
-		              [](vuk::BenchRunner& runner, vuk::Allocator& frame_allocator) {
-		              } },
-		.cases = { { "Dependent, small image",
-		             [](vuk::BenchRunner& runner, vuk::Allocator& frame_allocator, vuk::Query start, vuk::Query end, auto&& parameters) {
-		               auto ptc = ifc.begin();
-		               vuk::RenderGraph rg;
-		               rg.add_pass({ .resources = { "_final"_image(vuk::eColorWrite) }, .execute = [start, end, parameters](vuk::CommandBuffer& command_buffer) {
-			                            vuk::TimedScope _{ command_buffer, start, end };
-			                            command_buffer.set_viewport(0, vuk::Rect2D::framebuffer());
-			                            command_buffer
-			                                .set_scissor(0, vuk::Rect2D::framebuffer()) // Set the scissor area to cover the entire framebuffer
-			                                .bind_graphics_pipeline("triangle")         // Recall pipeline for "triangle" and bind
-			                                .draw(3 * parameters.n_iters, 1, 0, 0);     // Draw 3 vertices
-		                            } });
-		               return rg;
-		             } },
-		           { "Non-dependent, small image",
-		             [](vuk::BenchRunner& runner, vuk::Allocator& frame_allocator, vuk::Query start, vuk::Query end, auto&& parameters) {
-		               auto ptc = ifc.begin();
-		               vuk::RenderGraph rg;
-		               rg.add_pass({ .resources = { "_final"_image(vuk::eColorWrite) }, .execute = [start, end, parameters](vuk::CommandBuffer& command_buffer) {
-			                            vuk::TimedScope _{ command_buffer, start, end };
-			                            command_buffer.set_viewport(0, vuk::Rect2D::framebuffer());
-			                            command_buffer.set_scissor(0, vuk::Rect2D::framebuffer()).bind_graphics_pipeline("triangle");
-			                            for (auto i = 0; i < parameters.n_iters; i++) {
-				                            command_buffer.draw(3, 1, 0, 0);
-			                            }
-		                            } });
-		               return rg;
-		             } } }
+layout(location = 0) in vec4 in_color;
+layout(location = 0) out vec4 out_color;
+
+void main() {
+	out_color = in_color.bgra;
+}
+)";
+
+	using Color = std::array<float, 4>;
+
+	// state changed before every draw
+	enum class Change { eNone, ePipeline, eDescriptorSet, ePushConstants, eSpecializationConstants };
+
+	struct Case {
+		std::string_view label;
+		Change change;
 	};
 
-	REGISTER_BENCH(x);
-} // namespace
\ No newline at end of file
+	constexpr Case cases[] = { { "no state change", Change::eNone },
+		                         { "pipeline", Change::ePipeline },
+		                         { "descriptor set", Change::eDescriptorSet },
+		                         { "push constants", Change::ePushConstants },
+		                         { "specialization constants", Change::eSpecializationConstants } };
+
+	void record_draws(vuk::CommandBuffer& command_buffer, Change change, unsigned n_draws) {
+		for (unsigned i = 0; i < n_draws; i++) {
+			switch (change) {
+			case Change::eNone:
+				break;
+			case Change::ePipeline:
+				command_buffer.bind_graphics_pipeline(i & 1 ? "draw_b" : "draw_a");
+				break;
+			case Change::eDescriptorSet:
+				*command_buffer.map_scratch_uniform_binding<Color>(0, 0) = Color{ (float)(i & 1), 0.5f, 0.f, 1.f };
+				break;
+			case Change::ePushConstants:
+				command_buffer.push_constants(vuk::ShaderStageFlagBits::eVertex, 0, Color{ (i % 16) / 8.f - 1.f, (i / 16 % 16) / 8.f - 1.f, 0.f, 0.f });
+				break;
+			case Change::eSpecializationConstants:
+				command_buffer.specialize_constants(0, i & 1 ? 1.f : 0.5f);
+				break;
+			}
+			command_buffer.draw(4, 1, 0, 0);
+		}
+	}
+
+	// returns the CPU time spent recording the draws, in seconds
+	std::optional<double> run(util::HeadlessDevice& device, Change change, unsigned n_draws) {
+		auto& frame_resource = device.sfr->get_next_frame();
+		device.context->next_frame();
+		vuk::Allocator frame_allocator(frame_resource);
+
+		double elapsed = 0;
+		vuk::RenderGraph rg;
+		rg.add_pass({ .name = "draws",
+		              .resources = { "_final"_image >> vuk::eColorWrite },
+		              .execute = [&elapsed, change, n_draws](vuk::CommandBuffer& command_buffer) {
+			             command_buffer.set_viewport(0, vuk::Rect2D::framebuffer())
+			                 .set_scissor(0, vuk::Rect2D::framebuffer())
+			                 .set_rasterization({})
+			                 .set_primitive_topology(vuk::PrimitiveTopology::eTriangleStrip)
+			                 .broadcast_color_blend({})
+			                 .bind_graphics_pipeline("draw_a")
+			                 .push_constants(vuk::ShaderStageFlagBits::eVertex, 0, Color{})
+			                 .specialize_constants(0, 1.f);
+			             *command_buffer.map_scratch_uniform_binding<Color>(0, 0) = Color{ 1.f, 0.5f, 0.f, 1.f };
+
+			             auto start = std::chrono::steady_clock::now();
+			             record_draws(command_buffer, change, n_draws);
+			             elapsed = util::seconds_since(start);
+		             } });
+		rg.attach_managed("_final", vuk::Format::eR8G8B8A8Unorm, vuk::Dimension2D::absolute(256, 256), vuk::Samples::e1, vuk::ClearColor{ 0.f, 0.f, 0.f, 1.f });
+		auto erg = std::move(rg).link(*device.context, vuk::RenderGraph::CompileOptions{});
+		if (!erg.execute(frame_allocator, {})) {
+			return {};
+		}
+		return elapsed;
+	}
+} // namespace
+
+// usage: vuk_bench_draw_overhead [--runs N] [--warmup N] [--draws N]... [--json]
+int main(int argc, char** argv) {
+	bool json = false;
+	unsigned runs = 100;
+	unsigned warmup_runs = 10;
+	std::vector<unsigned> draw_counts;
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg == "--json") {
+			json = true;
+		} else if (arg == "--runs" && i + 1 < argc) {
+			runs = (unsigned)std::max(1, atoi(argv[++i]));
+		} else if (arg == "--warmup" && i + 1 < argc) {
+			warmup_runs = (unsigned)std::max(0, atoi(argv[++i]));
+		} else if (arg == "--draws" && i + 1 < argc) {
+			draw_counts.push_back((unsigned)std::max(1, atoi(argv[++i])));
+		} else {
+			fprintf(stderr, "usage: %s [--runs N] [--warmup N] [--draws N]... [--json]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (draw_counts.empty()) {
+		draw_counts = { 100, 1000 };
+	}
+
+	util::HeadlessDevice device;
+	if (!device.init("vuk_bench_draw_overhead")) {
+		fprintf(stderr, "could not create a Vulkan device\n");
+		return 1;
+	}
+	for (auto [name, fragment_shader] : { std::pair{ "draw_a", fragment_shader_a }, std::pair{ "draw_b", fragment_shader_b } }) {
+		vuk::PipelineBaseCreateInfo pci;
+		pci.add_glsl(vertex_shader, "draw_overhead.vert");
+		pci.add_glsl(fragment_shader, "draw_overhead.frag");
+		device.context->create_named_pipeline(name, pci);
+	}
+
+	if (json) {
+		printf("{\n\t\"bench\": \"draw_overhead\",\n\t\"results\": [");
+	}
+	bool first = true;
+	std::vector<double> timings;
+	for (auto& c : cases) {
+		for (auto n_draws : draw_counts) {
+			timings.clear();
+			for (unsigned run_index = 0; run_index < warmup_runs + runs; run_index++) {
+				auto elapsed = run(device, c.change, n_draws);
+				if (!elapsed) {
+					fprintf(stderr, "%s (%u draws): recording failed\n", c.label.data(), n_draws);
+					break;
+				}
+				// the first recordings create pipelines and fill caches
+				if (run_index >= warmup_runs) {
+					timings.push_back(*elapsed / n_draws);
+				}
+			}
+			if (timings.empty()) {
+				continue;
+			}
+			auto st = util::compute_statistics(timings);
+			if (json) {
+				printf("%s\n\t\t{ \"case\": \"%s\", \"draws\": %u, \"runs\": %zu, \"mean_ns_per_draw\": %f, \"variance_ns2\": %f, \"min_ns_per_draw\": %f, "
+				       "\"max_ns_per_draw\": %f }",
+				       first ? "" : ",",
+				       c.label.data(),
+				       n_draws,
+				       timings.size(),
+				       st.mean * 1e9,
+				       st.variance * 1e18,
+				       st.min * 1e9,
+				       st.max * 1e9);
+			} else {
+				printf("%-26s %6u draws: mu=%f ns/draw, sigma=%f ns2, min=%f ns/draw, max=%f ns/draw, runs: %zu\n",
+				       c.label.data(),
+				       n_draws,
+				       st.mean * 1e9,
+				       st.variance * 1e18,
+				       st.min * 1e9,
+				       st.max * 1e9,
+				       timings.size());
+			}
+			first = false;
+		}
+	}
+	if (json) {
+		printf("\n\t]\n}\n");
+	}
+}
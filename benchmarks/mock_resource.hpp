@@ -0,0 +1,242 @@
+#pragma once
+
+#include "vuk/Allocator.hpp"
+#include "vuk/Buffer.hpp"
+#include "vuk/Descriptor.hpp"
+#include "vuk/Image.hpp"
+#include "vuk/Query.hpp"
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace util {
+	/// @brief DeviceResource that fabricates handles without touching a device
+	/// Handles are unique, non-null and never dereferenced - they are only suitable for exercising CPU-side bookkeeping layered on top of a DeviceResource.
+	/// The number of live objects is tracked, so that leaks and double frees can be detected.
+	struct DeviceMockResource : vuk::DeviceResource {
+		std::atomic<uint64_t> next_handle = 1;
+		std::atomic<int64_t> live = 0;
+		std::atomic<uint64_t> allocations = 0;
+
+		template<class T>
+		T fabricate() {
+			return (T)(uintptr_t)next_handle.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		template<class T>
+		vuk::Result<void, vuk::AllocateException> track_allocation(std::span<T> dst) {
+			live.fetch_add((int64_t)dst.size(), std::memory_order_relaxed);
+			allocations.fetch_add(dst.size(), std::memory_order_relaxed);
+			return { vuk::expected_value };
+		}
+
+		template<class T>
+		void track_deallocation(std::span<const T> src) {
+			live.fetch_sub((int64_t)src.size(), std::memory_order_relaxed);
+		}
+
+		vuk::Result<void, vuk::AllocateException> allocate_semaphores(std::span<VkSemaphore> dst, vuk::SourceLocationAtFrame loc) override {
+			for (auto& d : dst) {
+				d = fabricate<VkSemaphore>();
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_semaphores(std::span<const VkSemaphore> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException> allocate_fences(std::span<VkFence> dst, vuk::SourceLocationAtFrame loc) override {
+			for (auto& d : dst) {
+				d = fabricate<VkFence>();
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_fences(std::span<const VkFence> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException> allocate_command_buffers(std::span<vuk::CommandBufferAllocation> dst,
+		                                                                   std::span<const vuk::CommandBufferAllocationCreateInfo> cis,
+		                                                                   vuk::SourceLocationAtFrame loc) override {
+			for (size_t i = 0; i < dst.size(); i++) {
+				dst[i] = vuk::CommandBufferAllocation{ fabricate<VkCommandBuffer>(), cis[i].command_pool };
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_command_buffers(std::span<const vuk::CommandBufferAllocation> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException>
+		allocate_command_pools(std::span<vuk::CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, vuk::SourceLocationAtFrame loc) override {
+			for (size_t i = 0; i < dst.size(); i++) {
+				dst[i] = vuk::CommandPool{ fabricate<VkCommandPool>(), cis[i].queueFamilyIndex };
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_command_pools(std::span<const vuk::CommandPool> src) override {
+			track_deallocation(src);
+		}
+
+		template<class T>
+		vuk::Result<void, vuk::AllocateException> fabricate_buffers(std::span<T> dst, std::span<const vuk::BufferCreateInfo> cis) {
+			for (size_t i = 0; i < dst.size(); i++) {
+				T b{};
+				b.buffer = fabricate<VkBuffer>();
+				b.size = cis[i].size;
+				b.allocation_size = cis[i].size;
+				b.memory_usage = cis[i].mem_usage;
+				dst[i] = b;
+			}
+			return track_allocation(dst);
+		}
+
+		vuk::Result<void, vuk::AllocateException>
+		allocate_buffers(std::span<vuk::BufferCrossDevice> dst, std::span<const vuk::BufferCreateInfo> cis, vuk::SourceLocationAtFrame loc) override {
+			return fabricate_buffers(dst, cis);
+		}
+
+		void deallocate_buffers(std::span<const vuk::BufferCrossDevice> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException>
+		allocate_buffers(std::span<vuk::BufferGPU> dst, std::span<const vuk::BufferCreateInfo> cis, vuk::SourceLocationAtFrame loc) override {
+			return fabricate_buffers(dst, cis);
+		}
+
+		void deallocate_buffers(std::span<const vuk::BufferGPU> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException>
+		allocate_framebuffers(std::span<VkFramebuffer> dst, std::span<const vuk::FramebufferCreateInfo> cis, vuk::SourceLocationAtFrame loc) override {
+			for (auto& d : dst) {
+				d = fabricate<VkFramebuffer>();
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_framebuffers(std::span<const VkFramebuffer> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException>
+		allocate_images(std::span<vuk::Image> dst, std::span<const vuk::ImageCreateInfo> cis, vuk::SourceLocationAtFrame loc) override {
+			for (auto& d : dst) {
+				d = fabricate<vuk::Image>();
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_images(std::span<const vuk::Image> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException>
+		allocate_image_views(std::span<vuk::ImageView> dst, std::span<const vuk::ImageViewCreateInfo> cis, vuk::SourceLocationAtFrame loc) override {
+			for (size_t i = 0; i < dst.size(); i++) {
+				vuk::ImageView iv{};
+				iv.payload = fabricate<VkImageView>();
+				iv.image = cis[i].image;
+				iv.format = cis[i].format;
+				iv.type = cis[i].viewType;
+				dst[i] = iv;
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_image_views(std::span<const vuk::ImageView> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException> allocate_persistent_descriptor_sets(std::span<vuk::PersistentDescriptorSet> dst,
+		                                                                              std::span<const vuk::PersistentDescriptorSetCreateInfo> cis,
+		                                                                              vuk::SourceLocationAtFrame loc) override {
+			for (auto& d : dst) {
+				d.backing_pool = fabricate<VkDescriptorPool>();
+				d.backing_set = fabricate<VkDescriptorSet>();
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_persistent_descriptor_sets(std::span<const vuk::PersistentDescriptorSet> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException>
+		allocate_descriptor_sets(std::span<vuk::DescriptorSet> dst, std::span<const vuk::SetBinding> cis, vuk::SourceLocationAtFrame loc) override {
+			for (size_t i = 0; i < dst.size(); i++) {
+				dst[i].descriptor_set = fabricate<VkDescriptorSet>();
+				if (cis[i].layout_info) {
+					dst[i].layout_info = *cis[i].layout_info;
+				}
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_descriptor_sets(std::span<const vuk::DescriptorSet> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException> allocate_timestamp_query_pools(std::span<vuk::TimestampQueryPool> dst,
+		                                                                         std::span<const VkQueryPoolCreateInfo> cis,
+		                                                                         vuk::SourceLocationAtFrame loc) override {
+			for (auto& d : dst) {
+				d.pool = fabricate<VkQueryPool>();
+				d.count = 0;
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_timestamp_query_pools(std::span<const vuk::TimestampQueryPool> src) override {
+			track_deallocation(src);
+		}
+
+		vuk::Result<void, vuk::AllocateException> allocate_timestamp_queries(std::span<vuk::TimestampQuery> dst,
+		                                                                     std::span<const vuk::TimestampQueryCreateInfo> cis,
+		                                                                     vuk::SourceLocationAtFrame loc) override {
+			for (size_t i = 0; i < dst.size(); i++) {
+				auto pool = cis[i].pool;
+				if (pool && pool->count >= vuk::TimestampQueryPool::num_queries) {
+					return { vuk::expected_error, vuk::AllocateException{ VK_ERROR_OUT_OF_POOL_MEMORY } };
+				}
+				dst[i].pool = pool ? pool->pool : fabricate<VkQueryPool>();
+				dst[i].id = pool ? pool->count : 0;
+				if (pool) {
+					pool->queries[pool->count++] = cis[i].query;
+				}
+			}
+			return { vuk::expected_value };
+		}
+
+		void deallocate_timestamp_queries(std::span<const vuk::TimestampQuery> src) override {}
+
+		vuk::Result<void, vuk::AllocateException> allocate_timeline_semaphores(std::span<vuk::TimelineSemaphore> dst, vuk::SourceLocationAtFrame loc) override {
+			for (auto& d : dst) {
+				d = { .semaphore = fabricate<VkSemaphore>(), .value = new uint64_t{ 0 } };
+			}
+			return track_allocation(dst);
+		}
+
+		void deallocate_timeline_semaphores(std::span<const vuk::TimelineSemaphore> src) override {
+			for (auto& s : src) {
+				delete s.value;
+			}
+			track_deallocation(src);
+		}
+
+		void deallocate_swapchains(std::span<const VkSwapchainKHR> src) override {}
+
+		// there is no Context backing the mock - anything requiring one needs a real device
+		vuk::Context& get_context() override {
+			fprintf(stderr, "DeviceMockResource has no Context\n");
+			abort();
+		}
+	};
+} // namespace util
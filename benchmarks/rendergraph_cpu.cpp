@@ -0,0 +1,256 @@
+#include "cpu_bench.hpp"
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/* CPU cost of the rendergraph
+ * Synthetic graphs of configurable size are built out of no-op passes and timed through compile, link and recording.
+ * Compilation does not touch the device, so it is always measured. With --device, a headless Vulkan device is created (lavapipe works)
+ * and link and recording (execute without submission) are measured as well.
+ */
+
+namespace {
+	vuk::Name indexed(std::string_view prefix, size_t i) {
+		return vuk::Name(std::string(prefix) + std::to_string(i));
+	}
+
+	// image resources that need to be attached before linking, along with the number of mips they need
+	struct Roots {
+		std::vector<vuk::Name> names;
+		uint32_t mip_levels = 1;
+	};
+
+	// pass i consumes the output of pass i - 1
+	Roots build_chain(vuk::RenderGraph& rg, unsigned size) {
+		for (unsigned i = 0; i < size; i++) {
+			rg.add_pass({ .name = indexed("chain_pass", i),
+			              .resources = { vuk::Resource(indexed("chain", i), vuk::Resource::Type::eImage, vuk::eComputeRW, indexed("chain", i + 1)) } });
+		}
+		return { { indexed("chain", 0) } };
+	}
+
+	// a producer, two readers and a consumer writing the original resource again, repeated
+	Roots build_diamonds(vuk::RenderGraph& rg, unsigned size) {
+		Roots roots{ { indexed("dia", 0) } };
+		for (unsigned i = 0; i < std::max(size / 4, 1u); i++) {
+			auto top = indexed("dia_top", i);
+			rg.add_pass({ .name = indexed("dia_top_pass", i),
+			              .resources = { vuk::Resource(indexed("dia", i), vuk::Resource::Type::eImage, vuk::eComputeRW, top) } });
+			for (auto side : { "dia_left", "dia_right" }) {
+				auto side_name = indexed(side, i);
+				roots.names.push_back(side_name);
+				rg.add_pass({ .name = side_name.append("_pass"),
+				              .resources = { vuk::Resource(top, vuk::Resource::Type::eImage, vuk::eComputeSampled),
+				                             vuk::Resource(side_name, vuk::Resource::Type::eImage, vuk::eComputeRW, side_name.append("+")) } });
+			}
+			rg.add_pass({ .name = indexed("dia_bottom_pass", i),
+			              .resources = { vuk::Resource(indexed("dia_left", i).append("+"), vuk::Resource::Type::eImage, vuk::eComputeSampled),
+			                             vuk::Resource(indexed("dia_right", i).append("+"), vuk::Resource::Type::eImage, vuk::eComputeSampled),
+			                             vuk::Resource(top, vuk::Resource::Type::eImage, vuk::eComputeRW, indexed("dia", i + 1)) } });
+		}
+		return roots;
+	}
+
+	// one producer read by many independent passes, gathered by a single pass
+	Roots build_fan_out(vuk::RenderGraph& rg, unsigned size) {
+		Roots roots{ { "fan_src" } };
+		rg.add_pass({ .name = "fan_src_pass", .resources = { vuk::Resource("fan_src", vuk::Resource::Type::eImage, vuk::eComputeRW, "fan_src+") } });
+		std::vector<vuk::Resource> gather;
+		for (unsigned i = 0; i < size; i++) {
+			auto dst = indexed("fan_dst", i);
+			roots.names.push_back(dst);
+			rg.add_pass({ .name = indexed("fan_pass", i),
+			              .resources = { vuk::Resource("fan_src+", vuk::Resource::Type::eImage, vuk::eComputeSampled),
+			                             vuk::Resource(dst, vuk::Resource::Type::eImage, vuk::eComputeRW, dst.append("+")) } });
+			gather.emplace_back(dst.append("+"), vuk::Resource::Type::eImage, vuk::eComputeSampled);
+		}
+		rg.add_pass({ .name = "fan_gather_pass", .resources = std::move(gather) });
+		return roots;
+	}
+
+	// mip chains written one level at a time, with every pass using a subrange of the image (like generate_mips)
+	Roots build_mip_chains(vuk::RenderGraph& rg, unsigned size) {
+		constexpr uint32_t mip_levels = 10;
+		Roots roots{ {}, mip_levels };
+		for (unsigned i = 0; i < std::max(size / (mip_levels - 1), 1u); i++) {
+			auto image = indexed("mip", i);
+			roots.names.push_back(image);
+			for (uint32_t level = 1; level < mip_levels; level++) {
+				auto src = level == 1 ? image : image.append("p");
+				vuk::Resource src_res(src, vuk::Resource::Type::eImage, vuk::eTransferRead);
+				src_res.subrange.image.base_level = level - 1;
+				src_res.subrange.image.level_count = 1;
+				vuk::Resource dst_res(image, vuk::Resource::Type::eImage, vuk::eTransferWrite, image.append("p"));
+				dst_res.subrange.image.base_level = level;
+				dst_res.subrange.image.level_count = 1;
+				rg.add_pass({ .name = image.append("_").append(indexed("level", level)), .resources = { src_res, dst_res } });
+			}
+		}
+		return roots;
+	}
+
+	struct Shape {
+		std::string_view label;
+		Roots (*build)(vuk::RenderGraph&, unsigned);
+	};
+
+	constexpr Shape shapes[] = { { "chain", build_chain }, { "diamonds", build_diamonds }, { "fan-out", build_fan_out }, { "mip chains", build_mip_chains } };
+
+	// textures are created on first use and reused across iterations
+	struct Device : util::HeadlessDevice {
+		std::unordered_map<vuk::Name, vuk::Texture> textures;
+
+		void attach(vuk::RenderGraph& rg, const Roots& roots) {
+			for (auto& name : roots.names) {
+				auto it = textures.find(name);
+				if (it == textures.end()) {
+					vuk::ImageCreateInfo ici{ .format = vuk::Format::eR8G8B8A8Unorm,
+						                        .extent = { .width = 512, .height = 512, .depth = 1 },
+						                        .mipLevels = roots.mip_levels,
+						                        .usage = vuk::ImageUsageFlagBits::eStorage | vuk::ImageUsageFlagBits::eSampled |
+						                                 vuk::ImageUsageFlagBits::eTransferSrc | vuk::ImageUsageFlagBits::eTransferDst };
+					it = textures.emplace(name, context->allocate_texture(*global, ici)).first;
+				}
+				rg.attach_image(name, vuk::ImageAttachment::from_texture(it->second), vuk::Access::eNone, vuk::Access::eNone);
+			}
+		}
+
+		~Device() {
+			textures.clear();
+		}
+	};
+
+	struct Result {
+		std::string_view shape;
+		unsigned size;
+		std::string_view phase;
+		util::Statistics statistics;
+		size_t runs;
+	};
+
+	void print_result(const Result& r, bool json, bool first) {
+		auto& st = r.statistics;
+		if (json) {
+			printf("%s\n\t\t{ \"shape\": \"%s\", \"size\": %u, \"phase\": \"%s\", \"runs\": %zu, \"mean_us\": %f, \"variance_us2\": %f, \"min_us\": %f, "
+			       "\"max_us\": %f }",
+			       first ? "" : ",",
+			       r.shape.data(),
+			       r.size,
+			       r.phase.data(),
+			       r.runs,
+			       st.mean * 1e6,
+			       st.variance * 1e12,
+			       st.min * 1e6,
+			       st.max * 1e6);
+		} else {
+			printf("%-10s %6u passes %-8s: mu=%f us, sigma=%f us2, min=%f us, max=%f us, runs: %zu\n",
+			       r.shape.data(),
+			       r.size,
+			       r.phase.data(),
+			       st.mean * 1e6,
+			       st.variance * 1e12,
+			       st.min * 1e6,
+			       st.max * 1e6,
+			       r.runs);
+		}
+	}
+} // namespace
+
+// usage: vuk_bench_rendergraph_cpu [--device] [--runs N] [--size N]... [--json]
+int main(int argc, char** argv) {
+	bool use_device = false;
+	bool json = false;
+	unsigned runs = 100;
+	std::vector<unsigned> sizes;
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg == "--device") {
+			use_device = true;
+		} else if (arg == "--json") {
+			json = true;
+		} else if (arg == "--runs" && i + 1 < argc) {
+			runs = (unsigned)std::max(1, atoi(argv[++i]));
+		} else if (arg == "--size" && i + 1 < argc) {
+			sizes.push_back((unsigned)std::max(1, atoi(argv[++i])));
+		} else {
+			fprintf(stderr, "usage: %s [--device] [--runs N] [--size N]... [--json]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (sizes.empty()) {
+		sizes = { 16, 128, 1024 };
+	}
+
+	std::optional<Device> device;
+	if (use_device) {
+		device.emplace();
+		if (!device->init("vuk_bench_rendergraph_cpu")) {
+			fprintf(stderr, "could not create a Vulkan device, only compilation will be measured\n");
+			device.reset();
+		}
+	}
+
+	std::vector<Result> results;
+	std::vector<double> timings;
+	for (auto& shape : shapes) {
+		for (auto size : sizes) {
+			timings.clear();
+			for (unsigned run = 0; run < runs; run++) {
+				vuk::RenderGraph rg;
+				shape.build(rg, size);
+				auto start = std::chrono::steady_clock::now();
+				rg.compile(vuk::RenderGraph::CompileOptions{});
+				timings.push_back(util::seconds_since(start));
+			}
+			results.push_back({ shape.label, size, "compile", util::compute_statistics(timings), timings.size() });
+
+			if (!device) {
+				continue;
+			}
+
+			std::vector<double> record_timings;
+			timings.clear();
+			for (unsigned run = 0; run < runs; run++) {
+				auto& frame_resource = device->sfr->get_next_frame();
+				device->context->next_frame();
+				vuk::Allocator frame_allocator(frame_resource);
+
+				vuk::RenderGraph rg;
+				auto roots = shape.build(rg, size);
+				device->attach(rg, roots);
+				auto start = std::chrono::steady_clock::now();
+				// link includes compilation
+				auto erg = std::move(rg).link(*device->context, vuk::RenderGraph::CompileOptions{});
+				timings.push_back(util::seconds_since(start));
+
+				// record the command buffers, but don't submit them - they are recycled with the frame
+				start = std::chrono::steady_clock::now();
+				auto bundle = erg.execute(frame_allocator, {});
+				record_timings.push_back(util::seconds_since(start));
+				if (!bundle) {
+					fprintf(stderr, "%s (%u): recording failed\n", shape.label.data(), size);
+					break;
+				}
+			}
+			results.push_back({ shape.label, size, "link", util::compute_statistics(timings), timings.size() });
+			if (record_timings.size() > 0) {
+				results.push_back({ shape.label, size, "record", util::compute_statistics(record_timings), record_timings.size() });
+			}
+		}
+	}
+
+	if (json) {
+		printf("{\n\t\"bench\": \"rendergraph_cpu\",\n\t\"results\": [");
+	}
+	for (size_t i = 0; i < results.size(); i++) {
+		print_result(results[i], json, i == 0);
+	}
+	if (json) {
+		printf("\n\t]\n}\n");
+	}
+
+	if (device) {
+		device->context->wait_idle();
+	}
+}
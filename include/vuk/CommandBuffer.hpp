@@ -11,6 +11,7 @@
 
 #include <optional>
 #include <utility>
+#include <vector>
 
 namespace vuk {
 	class Context;
@@ -177,6 +178,10 @@ namespace vuk {
 		std::optional<AllocateException> allocate_except;
 		std::optional<RenderGraphException> rg_except;
 
+		// Scratch memory - uniforms and indirect commands are sub-allocated from the current chunk
+		Buffer scratch_chunk = {};
+		size_t scratch_offset = 0;
+
 		// Pipeline state
 		// Enabled dynamic state
 		DynamicStateFlags dynamic_state_flags = {};
@@ -214,7 +219,11 @@ namespace vuk {
 
 		// Push constants
 		std::array<unsigned char, 128> push_constant_buffer;
-		fixed_vector<VkPushConstantRange, VUK_MAX_PUSHCONSTANT_RANGES> pcrs;
+		fixed_vector<VkPushConstantRange, VUK_MAX_PUSHCONSTANT_RANGES> pcrs; // pending, coalesced per stages
+		// contents and ranges last pushed to pushed_constants_layout - ranges whose contents have not changed are not pushed again
+		std::array<unsigned char, 128> pushed_constant_buffer;
+		fixed_vector<VkPushConstantRange, VUK_MAX_PUSHCONSTANT_RANGES> pushed_pcrs;
+		VkPipelineLayout pushed_constants_layout = VK_NULL_HANDLE;
 
 		// Descriptor sets
 		std::bitset<VUK_MAX_SETS> sets_used = {};
@@ -223,6 +232,12 @@ namespace vuk {
 		std::array<SetBinding, VUK_MAX_SETS> set_bindings = {};
 		std::bitset<VUK_MAX_SETS> persistent_sets_to_bind = {};
 		std::array<std::pair<VkDescriptorSet, VkDescriptorSetLayout>, VUK_MAX_SETS> persistent_sets = {};
+		// last descriptor set allocated for each set index - reused if the same bindings are bound again
+		std::array<SetBinding, VUK_MAX_SETS> last_set_bindings = {};
+		std::array<VkDescriptorSet, VUK_MAX_SETS> last_sets = {};
+		std::array<VkDescriptorSetLayout, VUK_MAX_SETS> last_set_layouts = {};
+		// descriptor sets allocated while recording - kept alive until the CommandBuffer is destroyed, as they may be bound again
+		std::vector<DescriptorSet> allocated_sets;
 
 		// for rendergraph
 		CommandBuffer(ExecutableRenderGraph& rg, Context& ctx, Allocator& allocator, VkCommandBuffer cb) :
@@ -245,6 +260,8 @@ namespace vuk {
 		    command_buffer(cb),
 		    ongoing_renderpass(ongoing) {}
 
+		~CommandBuffer();
+
 		/// @brief Retrieve parent context
 		Context& get_context() {
 			return ctx;
@@ -505,6 +522,11 @@ namespace vuk {
 		/// @param dst the Name of the destination Resource
 		/// @param copy_params parameters of the copy
 		CommandBuffer& copy_buffer_to_image(Name src, Name dst, BufferImageCopy copy_params);
+		/// @brief Copy a buffer resource into an image resource, with multiple regions in a single copy
+		/// @param src the Name of the source Resource
+		/// @param dst the Name of the destination Resource
+		/// @param copy_params parameters of the copy, one per region
+		CommandBuffer& copy_buffer_to_image(Name src, Name dst, std::span<const BufferImageCopy> copy_params);
 		/// @brief Copy an image resource into a buffer resource
 		/// @param src the Name of the source Resource
 		/// @param dst the Name of the destination Resource
@@ -555,6 +577,9 @@ namespace vuk {
 		[[nodiscard]] Exception&& error() &&;
 
 	protected:
+		/// @brief Sub-allocate CPUtoGPU memory from the scratch chunk of the command buffer, allocating a new chunk if needed
+		Result<Buffer, AllocateException> _allocate_scratch(size_t size, size_t alignment);
+
 		[[nodiscard]] bool _bind_state(bool graphics);
 		[[nodiscard]] bool _bind_compute_pipeline_state();
 		[[nodiscard]] bool _bind_graphics_pipeline_state();
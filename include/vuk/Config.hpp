@@ -51,6 +51,16 @@
 #define VUK_MAX_SCISSORS 1u
 #endif
 
+// number of bytes of host-visible memory command buffers sub-allocate scratch uniforms and indirect commands from at once
+#ifndef VUK_SCRATCH_CHUNK_SIZE
+#define VUK_SCRATCH_CHUNK_SIZE (64u * 1024u)
+#endif
+
+// compile in CPU tracing scopes (see vuk/Tracing.hpp)
+#ifndef VUK_ENABLE_TRACING
+#define VUK_ENABLE_TRACING 0
+#endif
+
 namespace vuk {
 	static constexpr bool use_exceptions = true;
 }
\ No newline at end of file
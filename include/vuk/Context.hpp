@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <coroutine>
 #include <optional>
 #include <span>
 #include <string_view>
@@ -124,6 +125,9 @@ namespace vuk {
 
 		size_t get_allocation_size(Buffer);
 
+		/// @brief Get the properties of the physical device of the Context
+		const VkPhysicalDeviceProperties& get_physical_device_properties() const;
+
 		/// @brief Add a swapchain to be managed by the Context
 		/// @return Reference to the new swapchain that can be used during presentation
 		SwapchainRef add_swapchain(Swapchain);
@@ -135,6 +139,18 @@ namespace vuk {
 		/// @brief Advance internal counter used for caching and garbage collect caches
 		void next_frame();
 
+		/// @brief Resume a coroutine once the timeline of the queue of a domain reaches a value
+		/// The coroutine is resumed from a later call to poll_awaiters(), on the thread calling it
+		/// @param domain Domain whose queue timeline is waited on
+		/// @param value Timeline value to wait for
+		/// @param handle Coroutine to resume
+		void add_awaiter(DomainFlagBits domain, uint64_t value, std::coroutine_handle<> handle);
+
+		/// @brief Resume the coroutines whose awaited queue timeline values have been reached, without blocking
+		/// Call this regularly (eg. once per frame) to drive coroutines suspended on Futures
+		/// @return the number of coroutines still waiting
+		size_t poll_awaiters();
+
 		/// @brief Wait for the device to become idle. Useful for only a few synchronisation events, like resizing or shutting down.
 		void wait_idle();
 
@@ -171,6 +187,11 @@ namespace vuk {
 		/// @return the duration in seconds if both timestamps were available, null optional otherwise
 		std::optional<double> retrieve_duration(Query q1, Query q2);
 
+		/// @brief Retrieve durations of timed passes if available
+		/// @param timings the PassTimings of an ExecutableRenderGraph
+		/// @return the duration in seconds of each pass for which both timestamps were available
+		std::vector<std::pair<Name, double>> retrieve_pass_durations(std::span<const struct PassTiming> timings);
+
 		/// @brief Retrieve results from `TimestampQueryPool`s and make them available to retrieve_timestamp and retrieve_duration
 		Result<void> make_timestamp_results_available(std::span<const TimestampQueryPool> pools);
 
@@ -264,6 +285,7 @@ namespace vuk {
 	struct ExecutableRenderGraph;
 
 	/// @brief Compile & link given `RenderGraph`s, then execute them into API VkCommandBuffers, then submit them to queues
+	/// `RenderGraph`s using the same Allocator are fused into a single `RenderGraph` before compilation
 	/// @param allocator Allocator to use for submission resources
 	/// @param rendergraphs `RenderGraph`s for compilation
 	Result<void> link_execute_submit(Allocator& allocator, std::span<std::pair<Allocator*, struct RenderGraph*>> rendergraphs);
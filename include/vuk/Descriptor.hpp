@@ -132,6 +132,8 @@ namespace vuk {
 			switch (type) {
 			case vuk::DescriptorType::eUniformBuffer:
 			case vuk::DescriptorType::eStorageBuffer:
+			case vuk::DescriptorType::eUniformBufferDynamic:
+			case vuk::DescriptorType::eStorageBufferDynamic:
 				return memcmp(&buffer, &o.buffer, sizeof(VkDescriptorBufferInfo)) == 0;
 			case vuk::DescriptorType::eStorageImage:
 			case vuk::DescriptorType::eSampledImage:
@@ -192,9 +194,11 @@ namespace vuk {
 	};
 
 	struct DescriptorPool {
-		void grow(Context& ptc, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info);
-		VkDescriptorSet acquire(Context& ptc, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info);
+		void grow(VkDevice device, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info);
+		VkDescriptorSet acquire(VkDevice device, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info);
+		void acquire(VkDevice device, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info, std::span<VkDescriptorSet> dst);
 		void release(VkDescriptorSet ds);
+		void release(std::span<const VkDescriptorSet> dss);
 		void destroy(VkDevice) const;
 
 		DescriptorPool();
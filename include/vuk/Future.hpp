@@ -5,8 +5,12 @@
 #include "vuk/ImageAttachment.hpp"
 #include "vuk/vuk_fwd.hpp"
 
+#include <coroutine>
+#include <exception>
 #include <memory>
+#include <optional>
 #include <span>
+#include <utility>
 
 // futures
 namespace vuk {
@@ -97,19 +101,105 @@ namespace vuk {
 		Result<void> submit();
 		/// @brief Wait and retrieve the result of the Future on the host
 		Result<T> get();
+		/// @brief Check if the result of a submitted Future is available on the host, without blocking
+		/// @return true if the result is available - get() will then return it without waiting
+		bool poll();
 		/// @brief Get control block for Future
 		FutureBase* get_control() {
 			return control.get();
 		}
+
+		/// @brief Awaiting a Future submits it if needed, then suspends the coroutine until the result is available on the host
+		/// The coroutine is resumed from Context::poll_awaiters()
+		struct Awaiter {
+			Future& future;
+			std::optional<Result<void>> submit_result;
+
+			bool await_ready() {
+				submit_result.emplace(future.submit());
+				return !*submit_result || future.poll();
+			}
+
+			void await_suspend(std::coroutine_handle<> handle) {
+				auto control = future.get_control();
+				control->get_allocator().get_context().add_awaiter(control->initial_domain, control->initial_visibility, handle);
+			}
+
+			Result<T> await_resume() {
+				if (!*submit_result) {
+					return { expected_error, submit_result->error() };
+				}
+				return future.get();
+			}
+		};
+
+		Awaiter operator co_await() {
+			return { *this };
+		}
+
 	private:
 		Name output_binding;
 
 		std::unique_ptr<RenderGraph> owned_rg;
 		RenderGraph* rg = nullptr;
 
-		std::unique_ptr<FutureBase> control;
+		// shared, so that producers completing the Future later (such as StreamingUploader) don't depend on the lifetime of the Future
+		std::shared_ptr<FutureBase> control;
 
 		friend struct RenderGraph;
+		friend class StreamingUploader;
+	};
+
+	/// @brief Coroutine type for composing Futures with co_await
+	/// The coroutine starts running immediately, and runs until it awaits a Future that is not available yet - it is then resumed from
+	/// Context::poll_awaiters(). The Task must be kept alive until done() returns true.
+	struct Task {
+		struct promise_type {
+			std::exception_ptr exception;
+
+			Task get_return_object() {
+				return { std::coroutine_handle<promise_type>::from_promise(*this) };
+			}
+			std::suspend_never initial_suspend() noexcept {
+				return {};
+			}
+			std::suspend_always final_suspend() noexcept {
+				return {};
+			}
+			void return_void() {}
+			void unhandled_exception() {
+				exception = std::current_exception();
+			}
+		};
+
+		Task() = default;
+		Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+		Task(Task&& o) noexcept : handle(std::exchange(o.handle, nullptr)) {}
+		Task& operator=(Task&& o) noexcept {
+			std::swap(handle, o.handle);
+			return *this;
+		}
+		~Task() {
+			if (handle) {
+				assert(handle.done() && "destroying a Task that is still waiting");
+				handle.destroy();
+			}
+		}
+
+		/// @brief Check if the coroutine has run to completion
+		bool done() const {
+			return !handle || handle.done();
+		}
+
+		/// @brief Rethrow the exception that escaped the coroutine, if any
+		void rethrow_if_failed() const {
+			if (handle && handle.promise().exception) {
+				std::rethrow_exception(handle.promise().exception);
+			}
+		}
+
+	private:
+		std::coroutine_handle<promise_type> handle;
 	};
 
 	template<class... Args>
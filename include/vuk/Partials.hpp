@@ -3,7 +3,9 @@
 #include "vuk/RenderGraph.hpp"
 #include "vuk/Future.hpp"
 #include <math.h>
+#include <numeric>
 #include <span>
+#include <vector>
 
 namespace vuk {
 	/// @brief Fill a buffer with host data
@@ -44,41 +46,148 @@ namespace vuk {
 		return host_data_to_buffer(allocator, copy_domain, dst, data.data(), data.size_bytes());
 	}
 
-	/// @brief Fill an image with host data
+	/// @brief Compute the copy regions of tightly packed image data, ordered by mip level and then by array layer (as in KTX files)
+	/// Each level starts at a multiple of both the texel block size and 4 bytes, as required for copies into images
+	/// @param format Format of the image
+	/// @param extent Extent of mip level 0 of the image
+	/// @param base_level first mip level in the data
+	/// @param level_count number of mip levels in the data
+	/// @param base_layer first array layer in the data
+	/// @param layer_count number of array layers in the data
+	/// @param regions Destination vector to place the regions into, one per mip level
+	/// @return size of the data in bytes
+	inline size_t compute_packed_image_regions(Format format,
+	                                           Extent3D extent,
+	                                           uint32_t base_level,
+	                                           uint32_t level_count,
+	                                           uint32_t base_layer,
+	                                           uint32_t layer_count,
+	                                           std::vector<BufferImageCopy>& regions) {
+		size_t alignment = std::lcm((size_t)format_to_texel_block_size(format), (size_t)4);
+		size_t offset = 0;
+		for (uint32_t level = base_level; level < base_level + level_count; level++) {
+			offset = (offset + alignment - 1) / alignment * alignment;
+			BufferImageCopy bc;
+			bc.bufferOffset = offset;
+			bc.bufferRowLength = 0;
+			bc.bufferImageHeight = 0;
+			bc.imageOffset = { 0, 0, 0 };
+			bc.imageExtent = Extent3D{ std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), std::max(extent.depth >> level, 1u) };
+			bc.imageSubresource.aspectMask = format_to_aspect(format);
+			bc.imageSubresource.mipLevel = level;
+			bc.imageSubresource.baseArrayLayer = base_layer;
+			bc.imageSubresource.layerCount = layer_count;
+			regions.push_back(bc);
+			offset += (size_t)compute_image_size(format, bc.imageExtent) * layer_count;
+		}
+		return offset;
+	}
+
+	/// @brief Fill an image with host data, copying any number of subresources with a single staging buffer and copy
 	/// @param allocator Allocator to use for temporary allocations
-	/// @param copy_domain The domain where the copy should happen (when dst is mapped, the copy happens on host)
+	/// @param copy_domain The domain where the copy should happen
 	/// @param image ImageAttachment to fill
 	/// @param src_data pointer to source data
-	inline Future<ImageAttachment> host_data_to_image(Allocator& allocator, DomainFlagBits copy_domain, ImageAttachment image, void* src_data) {
-		size_t alignment = format_to_texel_block_size(image.format);
-		assert(image.extent.sizing == Sizing::eAbsolute);
-		size_t size = compute_image_size(image.format, static_cast<Extent3D>(image.extent.extent));
+	/// @param size size of source data
+	/// @param regions copy regions, with buffer offsets relative to src_data
+	inline Future<ImageAttachment> host_data_to_image(Allocator& allocator,
+	                                                  DomainFlagBits copy_domain,
+	                                                  ImageAttachment image,
+	                                                  const void* src_data,
+	                                                  size_t size,
+	                                                  std::span<const BufferImageCopy> regions) {
+		size_t alignment = std::lcm((size_t)format_to_texel_block_size(image.format), (size_t)4);
 		auto src = *allocate_buffer_cross_device(allocator, BufferCreateInfo{ MemoryUsage::eCPUonly, size, alignment });
 		::memcpy(src->mapped_ptr, src_data, size);
 
-		BufferImageCopy bc;
-		bc.imageOffset = { 0, 0, 0 };
-		bc.bufferRowLength = 0;
-		bc.bufferImageHeight = 0;
-		bc.imageExtent = static_cast<Extent3D>(image.extent.extent);
-		bc.imageSubresource.aspectMask = format_to_aspect(image.format);
-		bc.imageSubresource.mipLevel = image.base_level;
-		bc.imageSubresource.baseArrayLayer = image.base_layer;
-		assert(image.layer_count == 1); // unsupported yet
-		bc.imageSubresource.layerCount = image.layer_count;
-
+		std::vector<BufferImageCopy> bcs(regions.begin(), regions.end());
 		std::unique_ptr<RenderGraph> rgp = std::make_unique<RenderGraph>();
 		rgp->add_pass({ .name = "IMAGE UPLOAD",
 		                .execute_on = copy_domain,
 		                .resources = { "_dst"_image >> vuk::Access::eTransferWrite, "_src"_buffer >> vuk::Access::eTransferRead },
-		                .execute = [bc](vuk::CommandBuffer& command_buffer) {
-			                command_buffer.copy_buffer_to_image("_src", "_dst", bc);
+		                .execute = [bcs = std::move(bcs)](vuk::CommandBuffer& command_buffer) {
+			                command_buffer.copy_buffer_to_image("_src", "_dst", std::span(bcs));
 		                } });
 		rgp->attach_buffer("_src", *src, vuk::Access::eNone, vuk::Access::eNone);
 		rgp->attach_image("_dst", image, vuk::Access::eNone, vuk::Access::eNone);
 		return { allocator, std::move(rgp), "_dst+" };
 	}
 
+	/// @brief Fill the base level of an image with host data
+	/// The source data holds the base level of every array layer referenced by the ImageAttachment, tightly packed. Other mip levels are not written
+	/// - to fill several levels at once, use the overload taking copy regions, with regions from compute_packed_image_regions().
+	/// @param allocator Allocator to use for temporary allocations
+	/// @param copy_domain The domain where the copy should happen (when dst is mapped, the copy happens on host)
+	/// @param image ImageAttachment to fill
+	/// @param src_data pointer to source data
+	inline Future<ImageAttachment> host_data_to_image(Allocator& allocator, DomainFlagBits copy_domain, ImageAttachment image, const void* src_data) {
+		assert(image.extent.sizing == Sizing::eAbsolute);
+		uint32_t layer_count = image.layer_count == VK_REMAINING_ARRAY_LAYERS ? 1 : image.layer_count;
+		std::vector<BufferImageCopy> regions;
+		size_t size = compute_packed_image_regions(
+		    image.format, static_cast<Extent3D>(image.extent.extent), image.base_level, 1, image.base_layer, layer_count, regions);
+		return host_data_to_image(allocator, copy_domain, image, src_data, size, regions);
+	}
+
+	/// @brief Copy a buffer into host-visible memory, to be read on the host once the copy completes
+	/// The returned Future is not waited on: submit() it and poll() it, reading the mapped memory of the result once it is available.
+	/// The memory is allocated from the allocator of the source Future, and stays valid as long as memory allocated from it would (for a frame
+	/// allocator, until the frame is recycled).
+	/// @param src Future of the Buffer to read back
+	/// @param size size of the data to read back
+	/// @param copy_domain The domain where the copy should happen
+	/// @return Future of a host-mapped Buffer holding the data
+	inline Future<Buffer> readback_buffer(Future<Buffer> src, size_t size, DomainFlagBits copy_domain = DomainFlagBits::eTransferQueue) {
+		auto& allocator = src.get_allocator();
+		auto dst = *allocate_buffer_cross_device(allocator, BufferCreateInfo{ MemoryUsage::eGPUtoCPU, size, 1 });
+
+		std::unique_ptr<RenderGraph> rgp = std::make_unique<RenderGraph>();
+		rgp->add_pass({ .name = "BUFFER READBACK",
+		                .execute_on = copy_domain,
+		                .resources = { "_src"_buffer >> vuk::Access::eTransferRead, "_dst"_buffer >> vuk::Access::eTransferWrite },
+		                .execute = [size](vuk::CommandBuffer& command_buffer) {
+			                command_buffer.copy_buffer("_src", "_dst", size);
+			                command_buffer.memory_barrier(vuk::Access::eTransferWrite, vuk::Access::eHostRead);
+		                } });
+		rgp->attach_in("_src", std::move(src), vuk::Access::eNone);
+		rgp->attach_buffer("_dst", *dst, vuk::Access::eNone, vuk::Access::eNone);
+		return { allocator, std::move(rgp), "_dst+", DomainFlagBits::eHost };
+	}
+
+	/// @brief Copy an image into host-visible memory, to be read on the host once the copy completes
+	/// The base level of the first layer_count layers of the image is copied, tightly packed as described by compute_packed_image_regions().
+	/// The returned Future is not waited on: submit() it and poll() it, reading the mapped memory of the result once it is available.
+	/// The memory is allocated from the allocator of the source Future, and stays valid as long as memory allocated from it would (for a frame
+	/// allocator, until the frame is recycled).
+	/// @param src Future of the ImageAttachment to read back
+	/// @param format Format of the image
+	/// @param extent Extent of the base level of the image
+	/// @param layer_count Number of layers to read back
+	/// @param copy_domain The domain where the copy should happen
+	/// @return Future of a host-mapped Buffer holding the data
+	inline Future<Buffer> readback_image(Future<ImageAttachment> src,
+	                                     Format format,
+	                                     Extent3D extent,
+	                                     uint32_t layer_count = 1,
+	                                     DomainFlagBits copy_domain = DomainFlagBits::eTransferQueue) {
+		auto& allocator = src.get_allocator();
+		std::vector<BufferImageCopy> regions;
+		size_t size = compute_packed_image_regions(format, extent, 0, 1, 0, layer_count, regions);
+		auto dst = *allocate_buffer_cross_device(allocator, BufferCreateInfo{ MemoryUsage::eGPUtoCPU, size, 1 });
+
+		std::unique_ptr<RenderGraph> rgp = std::make_unique<RenderGraph>();
+		rgp->add_pass({ .name = "IMAGE READBACK",
+		                .execute_on = copy_domain,
+		                .resources = { "_src"_image >> vuk::Access::eTransferRead, "_dst"_buffer >> vuk::Access::eTransferWrite },
+		                .execute = [bc = regions[0]](vuk::CommandBuffer& command_buffer) {
+			                command_buffer.copy_image_to_buffer("_src", "_dst", bc);
+			                command_buffer.memory_barrier(vuk::Access::eTransferWrite, vuk::Access::eHostRead);
+		                } });
+		rgp->attach_in("_src", std::move(src), vuk::Access::eNone);
+		rgp->attach_buffer("_dst", *dst, vuk::Access::eNone, vuk::Access::eNone);
+		return { allocator, std::move(rgp), "_dst+", DomainFlagBits::eHost };
+	}
+
 	/// @brief Transition image for given access - useful to force certain access across different RenderGraphs linked by Futures
 	/// @param image input Future of ImageAttachment
 	/// @param dst_access Access to have in the future
@@ -91,6 +200,7 @@ namespace vuk {
 	}
 
 	/// @brief Generate mips for given ImageAttachment
+	/// All levels are generated in a single pass, blitting every level from the previous one
 	/// @param image input Future of ImageAttachment
 	/// @param base_mip source mip level
 	/// @param num_mips number of mip levels to generate
@@ -98,46 +208,38 @@ namespace vuk {
 		auto& allocator = image.get_allocator();
 
 		std::unique_ptr<RenderGraph> rgp = std::make_unique<RenderGraph>();
-		for (uint32_t miplevel = base_mip + 1; miplevel < (base_mip + num_mips); miplevel++) {
-			uint32_t dmiplevel = miplevel - base_mip;
-			Name mip_dst = Name(std::to_string(miplevel));
-			Name src = Name("_src");
-			if (miplevel != base_mip + 1) {
-				src = src.append("p");
-			}
-			Resource src_res(src, Resource::Type::eImage, Access::eTransferRead);
-			src_res.subrange.image.base_level = miplevel - 1;
-			src_res.subrange.image.level_count = 1;
-			Resource dst_res("_src", Resource::Type::eImage, Access::eTransferWrite, "_srcp");
-			dst_res.subrange.image.base_level = miplevel;
-			dst_res.subrange.image.level_count = 1;
-			rgp->add_pass({ .name = Name("MIP").append(mip_dst),
-			                .execute_on = DomainFlagBits::eGraphicsOnGraphics,
-			                .resources = { src_res, dst_res },
-			                .execute = [src, dmiplevel, miplevel](CommandBuffer& command_buffer) {
-				                ImageBlit blit;
-				                auto src_ia = *command_buffer.get_resource_image_attachment(src);
-				                auto dim = src_ia.extent;
-				                assert(dim.sizing == Sizing::eAbsolute);
-				                auto extent = dim.extent;
-				                blit.srcSubresource.aspectMask = format_to_aspect(src_ia.format);
-				                blit.srcSubresource.baseArrayLayer = src_ia.base_layer;
-				                blit.srcSubresource.layerCount = src_ia.layer_count;
+		// the whole image is declared as written - levels are moved to the transfer source layout by the pass once they have been written
+		rgp->add_pass({ .name = "MIPS",
+		                .execute_on = DomainFlagBits::eGraphicsOnGraphics,
+		                .resources = { "_src"_image >> Access::eTransferWrite >> "_src+" },
+		                .execute = [base_mip, num_mips](CommandBuffer& command_buffer) {
+			                if (num_mips < 2) {
+				                return;
+			                }
+			                auto src_ia = *command_buffer.get_resource_image_attachment("_src");
+			                auto dim = src_ia.extent;
+			                assert(dim.sizing == Sizing::eAbsolute);
+			                auto extent = dim.extent;
+			                ImageBlit blit;
+			                blit.srcSubresource.aspectMask = format_to_aspect(src_ia.format);
+			                blit.srcSubresource.baseArrayLayer = src_ia.base_layer;
+			                blit.srcSubresource.layerCount = src_ia.layer_count;
+			                blit.dstSubresource = blit.srcSubresource;
+			                blit.srcOffsets[0] = Offset3D{ 0 };
+			                blit.dstOffsets[0] = Offset3D{ 0 };
+			                for (uint32_t miplevel = base_mip + 1; miplevel < (base_mip + num_mips); miplevel++) {
+				                command_buffer.image_barrier("_src", Access::eTransferWrite, Access::eTransferRead, miplevel - 1, 1);
 				                blit.srcSubresource.mipLevel = miplevel - 1;
-				                blit.srcOffsets[0] = Offset3D{ 0 };
-				                blit.srcOffsets[1] = Offset3D{ std::max((int32_t)extent.width >> (dmiplevel - 1), 1),
-					                                             std::max((int32_t)extent.height >> (dmiplevel - 1), 1),
-					                                             (int32_t)1 };
-				                blit.dstSubresource = blit.srcSubresource;
+				                blit.srcOffsets[1] =
+				                    Offset3D{ std::max((int32_t)extent.width >> (miplevel - 1), 1), std::max((int32_t)extent.height >> (miplevel - 1), 1), (int32_t)1 };
 				                blit.dstSubresource.mipLevel = miplevel;
-				                blit.dstOffsets[0] = Offset3D{ 0 };
 				                blit.dstOffsets[1] =
-				                    Offset3D{ std::max((int32_t)extent.width >> (dmiplevel), 1), std::max((int32_t)extent.height >> (dmiplevel), 1), (int32_t)1 };
-				                command_buffer.blit_image(src, "_srcp", blit, Filter::eLinear);
-			                } });
-		}
-
-		rgp->converge_image("_src", "_src+");
+				                    Offset3D{ std::max((int32_t)extent.width >> miplevel, 1), std::max((int32_t)extent.height >> miplevel, 1), (int32_t)1 };
+				                command_buffer.blit_image("_src", "_src", blit, Filter::eLinear);
+			                }
+			                // return the source levels to the layout the whole image is in for the rendergraph
+			                command_buffer.image_barrier("_src", Access::eTransferRead, Access::eTransferWrite, base_mip, num_mips - 1);
+		                } });
 
 		rgp->attach_in("_src", std::move(image), Access::eNone);
 		return { allocator, std::move(rgp), "_src+" };
@@ -55,6 +55,14 @@ namespace vuk {
 			variable_count_max[set] = max_descriptors;
 		}
 
+		// uniform and storage buffer bindings that are declared as dynamic
+		Bitset<VUK_MAX_SETS * VUK_MAX_BINDINGS> dynamic_buffer_bindings = {};
+		// declare a uniform or storage buffer binding as dynamic - the offset of the bound buffer is then supplied when the set is bound,
+		// so binding another range of the same buffer does not require a new descriptor set
+		void set_dynamic_buffer_binding(unsigned set, unsigned binding) noexcept {
+			dynamic_buffer_bindings.set(set * VUK_MAX_BINDINGS + binding);
+		}
+
 		vuk::fixed_vector<DescriptorSetLayoutCreateInfo, VUK_MAX_SETS> explicit_set_layouts = {};
 	};
 
@@ -96,7 +104,8 @@ namespace vuk {
 	public:
 		static vuk::fixed_vector<vuk::DescriptorSetLayoutCreateInfo, VUK_MAX_SETS> build_descriptor_layouts(const Program&, const PipelineBaseCreateInfoBase&);
 		bool operator==(const PipelineBaseCreateInfo& o) const noexcept {
-			return shaders == o.shaders && binding_flags == o.binding_flags && variable_count_max == o.variable_count_max;
+			return shaders == o.shaders && binding_flags == o.binding_flags && variable_count_max == o.variable_count_max &&
+			       dynamic_buffer_bindings == o.dynamic_buffer_bindings;
 		}
 	};
 
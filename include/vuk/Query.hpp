@@ -12,12 +12,15 @@ namespace vuk {
 		}
 	};
 
+	/// @brief A block of timestamp queries - frames chain as many blocks as they need, blocks are recycled once the frame completes
 	struct TimestampQueryPool {
-		static constexpr uint32_t num_queries = 32;
+		static constexpr uint32_t num_queries = 128;
 
 		VkQueryPool pool;
 		Query queries[num_queries];
-		uint8_t count = 0;
+		uint32_t count = 0;
+		// number of queries the pool was created with - only pools of num_queries are recycled
+		uint32_t capacity = num_queries;
 	};
 
 	struct TimestampQuery {
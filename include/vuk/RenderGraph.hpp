@@ -6,6 +6,7 @@
 #include "vuk/Image.hpp"
 #include "vuk/ImageAttachment.hpp"
 #include "vuk/MapProxy.hpp"
+#include "vuk/Query.hpp"
 #include "vuk/Result.hpp"
 #include "vuk/Swapchain.hpp"
 #include "vuk/vuk_fwd.hpp"
@@ -151,7 +152,7 @@ namespace vuk {
 		std::vector<Resource> resources;
 		std::unordered_map<Name, Name> resolves; // src -> dst
 
-		std::unique_ptr<FutureBase> wait;
+		std::shared_ptr<FutureBase> wait;
 		FutureBase* signal;
 
 		std::function<void(CommandBuffer&)> execute;
@@ -237,6 +238,10 @@ namespace vuk {
 			bool reorder_passes = true;
 			/// @brief check that pass ordering does not violate resource constraints (not needed when reordering passes)
 			bool check_pass_ordering = false;
+			/// @brief write timestamps around every named pass, see ExecutableRenderGraph::get_pass_timings
+			/// Passes that record their own secondary command buffers inside a render pass are not timed, as timestamps can't be written there
+			/// The graph must be executed with an Allocator backed by a DeviceFrameResource, which provides the timestamp queries - otherwise execution fails
+			bool time_passes = false;
 		};
 
 		/// @brief Consume this RenderGraph and create an ExecutableRenderGraph
@@ -280,8 +285,16 @@ namespace vuk {
 		void attach_out(Name, Future<Buffer>& fbuf, DomainFlags dst_domain);
 	};
 
+	/// @brief Timestamp queries written around the execution of a pass
+	struct PassTiming {
+		Name pass;
+		Query start;
+		Query end;
+	};
+
 	struct SubmitInfo {
 		std::vector<std::pair<DomainFlagBits, uint64_t>> relative_waits;
+		std::vector<std::pair<DomainFlagBits, uint64_t>> absolute_waits;
 		std::vector<VkCommandBuffer> command_buffers;
 		std::vector<FutureBase*> future_signals;
 		std::vector<SwapchainRef> used_swapchains;
@@ -315,6 +328,10 @@ namespace vuk {
 
 		Name resolve_name(Name, struct PassInfo*) const noexcept;
 
+		/// @brief Retrieve the timestamp queries of passes, if the graph was linked with CompileOptions::time_passes
+		/// the queries remain valid after this ExecutableRenderGraph is destroyed, results can be retrieved via Context::retrieve_pass_durations
+		std::span<const PassTiming> get_pass_timings() const;
+
 	private:
 		struct RGImpl* impl;
 
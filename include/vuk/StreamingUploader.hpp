@@ -0,0 +1,55 @@
+#pragma once
+
+#include "vuk/Allocator.hpp"
+#include "vuk/Future.hpp"
+#include "vuk/ImageAttachment.hpp"
+#include "vuk/vuk_fwd.hpp"
+
+namespace vuk {
+	/// @brief Batches many host to device uploads into a single transfer queue submission
+	/// Host data is copied into a persistent ring staging buffer when an upload is enqueued. flush() records every enqueued copy into one command buffer
+	/// and submits it to the transfer queue, signalling the timeline semaphore of the queue. Staging memory is reused once the timeline passes the value
+	/// signalled by the submission that read it.
+	/// Futures returned from upload() are not available until the next flush(). They may be dropped before the flush(), the upload is still performed.
+	class StreamingUploader {
+	public:
+		/// @brief Create a StreamingUploader
+		/// @param allocator Allocator to allocate the staging buffer from - must outlive the StreamingUploader
+		/// @param staging_size Size of the ring staging buffer in bytes - a single upload can't be larger than this
+		StreamingUploader(Allocator& allocator, size_t staging_size = 64 * 1024 * 1024);
+		~StreamingUploader();
+
+		StreamingUploader(const StreamingUploader&) = delete;
+		StreamingUploader& operator=(const StreamingUploader&) = delete;
+
+		/// @brief Enqueue filling a buffer with host data (when dst is mapped, the copy happens immediately on host)
+		/// @param allocator Allocator to use for submitting pending uploads, if the staging buffer is full
+		/// @param dst Buffer to fill
+		/// @param src_data pointer to source data
+		/// @param size size of source data
+		/// @return Future of the filled Buffer, submitted on the next flush()
+		Result<Future<Buffer>> upload(Allocator& allocator, Buffer dst, const void* src_data, size_t size);
+
+		/// @brief Enqueue filling an image with host data
+		/// Fills the base level of the layers referenced by the ImageAttachment, with the layers tightly packed in the source data
+		/// The whole image is transitioned from an undefined layout - the contents of the levels and layers not filled are discarded
+		/// @param allocator Allocator to use for submitting pending uploads, if the staging buffer is full
+		/// @param dst ImageAttachment to fill
+		/// @param src_data pointer to source data
+		/// @param dst_domain Queue on which the image will be used next - the ownership of the image is released to this queue
+		/// @return Future of the filled ImageAttachment, submitted on the next flush()
+		Result<Future<ImageAttachment>>
+		upload(Allocator& allocator, ImageAttachment dst, const void* src_data, DomainFlagBits dst_domain = DomainFlagBits::eGraphicsQueue);
+
+		/// @brief Submit all enqueued uploads to the transfer queue, in a single submission
+		/// @param allocator Allocator to use for the command buffer and fence of the submission (typically the frame allocator)
+		Result<void> flush(Allocator& allocator);
+
+		/// @brief Reclaim the staging memory of completed submissions, without blocking
+		/// @return the last value of the transfer queue timeline known to be reached
+		uint64_t collect();
+
+	private:
+		struct StreamingUploaderImpl* impl;
+	};
+} // namespace vuk
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "vuk/Config.hpp"
+
+#include <stdint.h>
+#include <string>
+
+namespace vuk {
+	/// @brief Enable or disable recording of trace events at runtime
+	/// has no effect if vuk was built without VUK_ENABLE_TRACING
+	void set_tracing_enabled(bool enabled);
+	/// @brief Check if trace events are currently being recorded
+	bool is_tracing_enabled();
+	/// @brief Discard all recorded trace events
+	void clear_trace();
+	/// @brief Export all recorded trace events in the Chrome trace event format (viewable in chrome://tracing or Perfetto)
+	/// @return JSON document containing the trace events
+	std::string export_chrome_trace();
+
+	/// @brief Records the CPU time spent between construction and destruction into the calling thread's trace
+	struct TraceScope {
+		/// @param name Name of the scope - must outlive the trace (string literal)
+		TraceScope(const char* name) noexcept;
+		~TraceScope();
+
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+
+	private:
+		const char* name;
+		uint64_t start;
+	};
+} // namespace vuk
+
+#define VUK_TRACE_CONCAT_IMPL(a, b) a##b
+#define VUK_TRACE_CONCAT(a, b)      VUK_TRACE_CONCAT_IMPL(a, b)
+
+#if VUK_ENABLE_TRACING
+#define VUK_TRACE_SCOPE(name) ::vuk::TraceScope VUK_TRACE_CONCAT(_vuk_trace_scope_, __LINE__)(name)
+#else
+#define VUK_TRACE_SCOPE(name)
+#endif
@@ -4,6 +4,8 @@
 #include "vuk/resources/DeviceNestedResource.hpp"
 #include "vuk/resources/DeviceVkResource.hpp"
 
+#include <chrono>
+
 namespace vuk {
 	struct DeviceSuperFrameResource;
 	
@@ -94,6 +96,9 @@ namespace vuk {
 		/// Called automatically when recycled
 		void wait();
 
+		/// @brief Check if the fences / timeline semaphores referencing this frame have completed, without blocking
+		bool is_ready();
+
 		/// @brief Retrieve the parent Context
 		/// @return the parent Context
 		Context& get_context() override {
@@ -112,12 +117,31 @@ namespace vuk {
 		DeviceFrameResource(VkDevice device, DeviceSuperFrameResource& upstream);
 	};
 
+	/// @brief Frame pacing statistics, collected when DeviceSuperFrameResource recycles frames
+	struct FramePacingStatistics {
+		/// @brief Number of frames recycled so far
+		uint64_t frames_recycled = 0;
+		/// @brief Time spent blocking on the GPU when acquiring the last frame
+		std::chrono::nanoseconds last_wait{};
+		/// @brief Moving average of the time spent blocking on the GPU when acquiring a frame
+		std::chrono::nanoseconds average_wait{};
+		/// @brief Longest time spent blocking on the GPU when acquiring a frame
+		std::chrono::nanoseconds max_wait{};
+		/// @brief Time between handing out the last recycled frame and observing its completion
+		std::chrono::nanoseconds last_latency{};
+		/// @brief Moving average of the time between handing out a frame and observing its completion
+		std::chrono::nanoseconds average_latency{};
+	};
+
 	/// @brief DeviceSuperFrameResource is an allocator that gives out DeviceFrameResource allocators, and manages their resources
 	///
 	/// DeviceSuperFrameResource models resource lifetimes that span multiple frames - these can be allocated directly from this resource
 	/// Allocation of these resources are persistent, and they can be deallocated at any time - they will be recycled when the current frame is recycled
 	/// This resource also hands out DeviceFrameResources in a round-robin fashion.
 	/// The lifetime of resources allocated from those allocators is frames_in_flight number of frames (until the DeviceFrameResource is recycled).
+	/// Semaphores and fences are pooled: when a frame is recycled, its semaphores and (reset) fences are handed out again instead of being destroyed.
+	/// Images and image views allocated from frames are pooled by their create info and reused by matching requests, pooled entries that go unused for a few frames are destroyed.
+	/// Images and image views allocated directly from the DeviceSuperFrameResource are never taken from or returned to the pools.
 	struct DeviceSuperFrameResource : DeviceResource {
 		DeviceSuperFrameResource(Context& ctx, uint64_t frames_in_flight);
 
@@ -193,18 +217,41 @@ namespace vuk {
 		/// @return DeviceFrameResource for use
 		DeviceFrameResource& get_next_frame();
 
+		/// @brief Recycle the least-recently-used frame if it has completed on the GPU, without blocking
+		/// @return DeviceFrameResource for use, or nullptr if the frame is still in use or another thread is acquiring a frame
+		DeviceFrameResource* try_get_next_frame();
+
+		/// @brief Change the number of frames cycled through, takes effect when the next frame is acquired
+		/// @param count number of frames in flight, between 1 and the frames_in_flight given at construction
+		void set_frames_in_flight(uint64_t count);
+
+		/// @brief Get the number of frames cycled through
+		uint64_t get_frames_in_flight() const;
+
+		/// @brief Retrieve the frame pacing statistics
+		FramePacingStatistics get_pacing_statistics() const;
+
+		/// @brief Enable or disable releasing the resources of recycled frames on a background thread
+		///
+		/// Acquiring a frame still waits for the GPU to finish with it, but destroying and pooling the resources of the frame is moved off the calling thread.
+		void set_background_deallocation(bool enable);
+
 		virtual ~DeviceSuperFrameResource();
 
 		Context& get_context() override {
 			return *direct.ctx;
 		}
 
+		/// @brief Maximum number of frames in flight
 		const uint64_t frames_in_flight;
 		DeviceVkResource direct;
 	private:
 		DeviceFrameResource& get_last_frame();
+		DeviceFrameResource* acquire_next_frame(bool block);
 		void deallocate_frame(DeviceFrameResource& f);
 
 		struct DeviceSuperFrameResourceImpl* impl;
+
+		friend struct DeviceFrameResource;
 	};
 } // namespace vuk
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "LegacyGPUAllocator.hpp"
 #include "vuk/Context.hpp"
 #include "vuk/PipelineInstance.hpp"
+#include "vuk/Tracing.hpp"
 
 #include <plf_colony.h>
 #include <robin_hood.h>
@@ -43,6 +44,7 @@ namespace vuk {
 
 	template<class T>
 	void Cache<T>::collect(uint64_t current_frame, size_t threshold) {
+		VUK_TRACE_SCOPE("Cache::collect");
 		std::unique_lock _(impl->cache_mtx);
 		for (auto it = impl->lru_map.begin(); it != impl->lru_map.end();) {
 			auto last_use_frame = it->second.last_use_frame;
@@ -151,6 +153,7 @@ namespace vuk {
 
 	template<>
 	void Cache<PipelineInfo>::collect(uint64_t current_frame, size_t threshold) {
+		VUK_TRACE_SCOPE("Cache::collect");
 		std::unique_lock _(impl->cache_mtx);
 		for (auto it = impl->lru_map.begin(); it != impl->lru_map.end();) {
 			auto last_use_frame = it->second.last_use_frame;
@@ -3,6 +3,9 @@
 #include "vuk/AllocatorHelpers.hpp"
 #include "vuk/Context.hpp"
 #include "vuk/RenderGraph.hpp"
+#include "vuk/Tracing.hpp"
+
+#include <algorithm>
 
 #define VUK_EARLY_RET()                                                                                                                                        \
 	if (current_exception) {                                                                                                                                     \
@@ -17,6 +20,51 @@ namespace vuk {
 		return format_to_texel_block_size(format);
 	}
 
+	// add a range to a set of push constant ranges, coalescing it with the ranges of the same stages it overlaps or is adjacent to
+	// if drop_overlapping is set, overlapping ranges of other stages are removed and a full set is restarted
+	// otherwise returns false without adding the range if the set is full
+	static bool
+	merge_push_constant_range(fixed_vector<VkPushConstantRange, VUK_MAX_PUSHCONSTANT_RANGES>& ranges, VkPushConstantRange range, bool drop_overlapping) {
+		for (size_t i = 0; i < ranges.size();) {
+			auto& r = ranges[i];
+			auto begin = std::min(r.offset, range.offset);
+			auto end = std::max(r.offset + r.size, range.offset + range.size);
+			bool same_stages = r.stageFlags == range.stageFlags;
+			if ((same_stages && end - begin <= r.size + range.size) || (drop_overlapping && end - begin < r.size + range.size)) {
+				if (same_stages) {
+					range.offset = begin;
+					range.size = end - begin;
+				}
+				r = ranges[ranges.size() - 1];
+				ranges.pop_back();
+			} else {
+				i++;
+			}
+		}
+		if (ranges.full()) {
+			if (!drop_overlapping) {
+				return false;
+			}
+			// only forgets what was pushed - the ranges are pushed again on the next bind
+			ranges.clear();
+		}
+		ranges.push_back(range);
+		return true;
+	}
+
+	// compare the used bindings of two finalized SetBindings
+	static bool is_same_set_binding(const SetBinding& a, const SetBinding& b) {
+		if (a.used != b.used) {
+			return false;
+		}
+		for (unsigned j = 0; j < VUK_MAX_BINDINGS; j++) {
+			if (a.used.test(j) && !(a.bindings[j] == b.bindings[j])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	FormatOrIgnore::FormatOrIgnore(Format format) : ignore(false), format(format), size(format_to_texel_block_size(format)) {}
 	FormatOrIgnore::FormatOrIgnore(Ignore ign) : ignore(true), format(ign.format), size(ign.to_size()) {}
 
@@ -333,7 +381,11 @@ namespace vuk {
 
 	CommandBuffer& CommandBuffer::push_constants(ShaderStageFlags stages, size_t offset, void* data, size_t size) {
 		VUK_EARLY_RET();
-		pcrs.push_back(VkPushConstantRange{ (VkShaderStageFlags)stages, (uint32_t)offset, (uint32_t)size });
+		if (!merge_push_constant_range(pcrs, VkPushConstantRange{ (VkShaderStageFlags)stages, (uint32_t)offset, (uint32_t)size }, false)) {
+			rg_except.emplace(RenderGraphException{ "Too many disjoint push constant ranges - increase VUK_MAX_PUSHCONSTANT_RANGES." });
+			current_exception = &rg_except.value();
+			return *this;
+		}
 		void* dst = push_constant_buffer.data() + offset;
 		::memcpy(dst, data, size);
 		return *this;
@@ -424,18 +476,39 @@ namespace vuk {
 			return nullptr;
 		}
 
-		auto res = allocate_buffer_cross_device(*allocator, { MemoryUsage::eCPUtoGPU, size, 1 });
+		// the binding type is only known when binding state, and the buffer may end up bound as a (dynamic) uniform or storage buffer
+		auto& limits = ctx.get_physical_device_properties().limits;
+		auto res = _allocate_scratch(size, std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment));
 		if (!res) {
 			allocate_except.emplace(res.error());
 			current_exception = &allocate_except.value();
 			return nullptr;
 		} else {
-			auto& buf = res->get();
-			bind_buffer(set, binding, buf);
-			return buf.mapped_ptr;
+			bind_buffer(set, binding, *res);
+			return res->mapped_ptr;
 		}
 	}
 
+	Result<Buffer, AllocateException> CommandBuffer::_allocate_scratch(size_t size, size_t alignment) {
+		auto offset = (scratch_offset + alignment - 1) / alignment * alignment;
+		if (scratch_chunk.buffer != VK_NULL_HANDLE && offset + size <= scratch_chunk.size) {
+			scratch_offset = offset + size;
+			return { expected_value, scratch_chunk.subrange(offset, size) };
+		}
+		// allocations larger than a chunk get their own buffer, leaving the current chunk in place
+		bool dedicated = size > VUK_SCRATCH_CHUNK_SIZE;
+		auto res = allocate_buffer_cross_device(*allocator, { MemoryUsage::eCPUtoGPU, dedicated ? size : VUK_SCRATCH_CHUNK_SIZE, alignment });
+		if (!res) {
+			return { expected_error, res.error() };
+		}
+		if (dedicated) {
+			return { expected_value, res->get() };
+		}
+		scratch_chunk = res->get();
+		scratch_offset = size;
+		return { expected_value, scratch_chunk.subrange(0, size) };
+	}
+
 	CommandBuffer& CommandBuffer::draw(size_t vertex_count, size_t instance_count, size_t first_vertex, size_t first_instance) {
 		VUK_EARLY_RET();
 		if (!_bind_graphics_pipeline_state()) {
@@ -471,7 +544,7 @@ namespace vuk {
 			return *this;
 		}
 
-		auto res = allocate_buffer_cross_device(*allocator, { MemoryUsage::eCPUtoGPU, cmds.size_bytes(), 1 });
+		auto res = _allocate_scratch(cmds.size_bytes(), alignof(DrawIndexedIndirectCommand));
 		if (!res) {
 			allocate_except.emplace(res.error());
 			current_exception = &allocate_except.value();
@@ -479,8 +552,8 @@ namespace vuk {
 		}
 
 		auto& buf = *res;
-		memcpy(buf->mapped_ptr, cmds.data(), cmds.size_bytes());
-		vkCmdDrawIndexedIndirect(command_buffer, buf->buffer, (uint32_t)buf->offset, (uint32_t)cmds.size(), sizeof(DrawIndexedIndirectCommand));
+		memcpy(buf.mapped_ptr, cmds.data(), cmds.size_bytes());
+		vkCmdDrawIndexedIndirect(command_buffer, buf.buffer, (uint32_t)buf.offset, (uint32_t)cmds.size(), sizeof(DrawIndexedIndirectCommand));
 		return *this;
 	}
 
@@ -532,6 +605,12 @@ namespace vuk {
 		return *this;
 	}
 
+	CommandBuffer::~CommandBuffer() {
+		if (allocator && allocated_sets.size() > 0) {
+			allocator->deallocate(std::span<const DescriptorSet>(allocated_sets));
+		}
+	}
+
 	Result<SecondaryCommandBuffer> CommandBuffer::begin_secondary() {
 		if (current_exception) {
 			return { expected_error, *current_exception };
@@ -694,6 +773,10 @@ namespace vuk {
 	}
 
 	CommandBuffer& CommandBuffer::copy_buffer_to_image(Name src, Name dst, BufferImageCopy bic) {
+		return copy_buffer_to_image(src, dst, std::span{ &bic, 1 });
+	}
+
+	CommandBuffer& CommandBuffer::copy_buffer_to_image(Name src, Name dst, std::span<const BufferImageCopy> bics) {
 		VUK_EARLY_RET();
 		assert(rg);
 		auto src_res = rg->get_resource_buffer(src, current_pass);
@@ -703,7 +786,6 @@ namespace vuk {
 			return *this;
 		}
 		auto src_bbuf = src_res->buffer;
-		bic.bufferOffset += src_bbuf.offset;
 
 		auto dst_res = rg->get_resource_image(dst, current_pass);
 		if (!dst_res) {
@@ -720,7 +802,12 @@ namespace vuk {
 			return *this;
 		}
 		auto dst_layout = *res_gl ? ImageLayout::eGeneral : ImageLayout::eTransferDstOptimal;
-		vkCmdCopyBufferToImage(command_buffer, src_bbuf.buffer, dst_image, (VkImageLayout)dst_layout, 1, (VkBufferImageCopy*)&bic);
+		// region offsets are relative to the buffer
+		std::vector<VkBufferImageCopy> regions(bics.begin(), bics.end());
+		for (auto& region : regions) {
+			region.bufferOffset += src_bbuf.offset;
+		}
+		vkCmdCopyBufferToImage(command_buffer, src_bbuf.buffer, dst_image, (VkImageLayout)dst_layout, (uint32_t)regions.size(), regions.data());
 
 		return *this;
 	}
@@ -896,10 +983,24 @@ namespace vuk {
 	}
 
 	bool CommandBuffer::_bind_state(bool graphics) {
+		VUK_TRACE_SCOPE("CommandBuffer::_bind_state");
+		auto pipeline_layout = graphics ? current_pipeline->pipeline_layout : current_compute_pipeline->pipeline_layout;
+		if (pipeline_layout != pushed_constants_layout) {
+			pushed_pcrs.clear();
+			pushed_constants_layout = pipeline_layout;
+		}
 		for (auto& pcr : pcrs) {
-			void* data = push_constant_buffer.data() + pcr.offset;
-			vkCmdPushConstants(
-			    command_buffer, graphics ? current_pipeline->pipeline_layout : current_compute_pipeline->pipeline_layout, pcr.stageFlags, pcr.offset, pcr.size, data);
+			auto data = push_constant_buffer.data() + pcr.offset;
+			auto pushed_data = pushed_constant_buffer.data() + pcr.offset;
+			bool unchanged = std::any_of(pushed_pcrs.begin(), pushed_pcrs.end(), [&](const VkPushConstantRange& p) {
+				return p.stageFlags == pcr.stageFlags && p.offset <= pcr.offset && pcr.offset + pcr.size <= p.offset + p.size;
+			}) && memcmp(data, pushed_data, pcr.size) == 0;
+			if (unchanged) {
+				continue;
+			}
+			vkCmdPushConstants(command_buffer, pipeline_layout, pcr.stageFlags, pcr.offset, pcr.size, data);
+			memcpy(pushed_data, data, pcr.size);
+			merge_push_constant_range(pushed_pcrs, pcr, true);
 		}
 		pcrs.clear();
 
@@ -907,6 +1008,17 @@ namespace vuk {
 		auto persistent_sets_mask = persistent_sets_to_bind.to_ulong();
 		uint32_t highest_undisturbed_binding_required = 0;
 		uint32_t lowest_disturbed_binding = VUK_MAX_SETS;
+		// sets are validated and finalized first, then allocated and bound together
+		std::array<SetBinding, VUK_MAX_SETS> sbs;
+		// dynamic offsets of the sets bound now, in set and binding order
+		std::array<uint32_t, VUK_MAX_SETS * VUK_MAX_BINDINGS> dynamic_offsets;
+		std::array<uint32_t, VUK_MAX_SETS> dynamic_offset_begin = {};
+		std::array<uint32_t, VUK_MAX_SETS> dynamic_offset_count = {};
+		uint32_t num_dynamic_offsets = 0;
+		std::array<uint32_t, VUK_MAX_SETS> set_indices;
+		uint32_t num_sets_to_allocate = 0;
+		std::array<VkDescriptorSet, VUK_MAX_SETS> sets_to_bind_now;
+		std::bitset<VUK_MAX_SETS> bound_now;
 		for (unsigned i = 0; i < VUK_MAX_SETS; i++) {
 			bool set_to_bind = sets_mask & (1 << i);
 			bool persistent_set_to_bind = persistent_sets_mask & (1 << i);
@@ -941,6 +1053,8 @@ namespace vuk {
 				lowest_disturbed_binding = std::min(lowest_disturbed_binding, i + 1);
 			}
 			set_bindings[i].layout_info = graphics ? &current_pipeline->layout_info[i] : &current_compute_pipeline->layout_info[i];
+			// every bound set starts its (possibly empty) range of dynamic offsets, as consecutive sets are bound together
+			dynamic_offset_begin[i] = num_dynamic_offsets;
 			if (!persistent_set_to_bind) {
 				auto sb = set_bindings[i].finalize();
 				auto& pipeline_set_bindings = graphics ? current_pipeline->base->dslcis[i].bindings : current_compute_pipeline->base->dslcis[i].bindings;
@@ -956,6 +1070,11 @@ namespace vuk {
 						cbuf_binding.type = DescriptorType::eStorageBuffer;
 						continue;
 					}
+					if (cbuf_dtype == DescriptorType::eUniformBuffer &&
+					    (pipe_dtype == DescriptorType::eUniformBufferDynamic || pipe_dtype == DescriptorType::eStorageBufferDynamic)) {
+						cbuf_binding.type = pipe_dtype;
+						continue;
+					}
 					// storage image from any image
 					if ((cbuf_dtype == DescriptorType::eSampledImage || cbuf_dtype == DescriptorType::eCombinedImageSampler) &&
 					    pipe_dtype == DescriptorType::eStorageImage) {
@@ -987,34 +1106,76 @@ namespace vuk {
 					}
 				}
 
-				Unique<DescriptorSet> ds;
-				if (auto ret = allocator->allocate_descriptor_sets(std::span{ &*ds, 1 }, std::span{ &sb, 1 }); !ret) {
-					allocate_except.emplace(ret.error());
-					current_exception = &allocate_except.value();
-					return false;
+				// the offsets of dynamic buffers are passed when binding, so that the set only depends on the buffers
+				for (unsigned j = 0; j < VUK_MAX_BINDINGS; j++) {
+					auto& binding = sb.bindings[j];
+					if (sb.used.test(j) && (binding.type == DescriptorType::eUniformBufferDynamic || binding.type == DescriptorType::eStorageBufferDynamic)) {
+						dynamic_offsets[num_dynamic_offsets++] = (uint32_t)binding.buffer.offset;
+						binding.buffer.offset = 0;
+					}
+				}
+				dynamic_offset_count[i] = num_dynamic_offsets - dynamic_offset_begin[i];
+
+				// the layout is compared by handle, as layout_info points into the currently bound pipeline
+				if (last_sets[i] != VK_NULL_HANDLE && last_set_layouts[i] == sb.layout_info->layout && is_same_set_binding(sb, last_set_bindings[i])) {
+					sets_to_bind_now[i] = last_sets[i];
+					set_layouts_used[i] = sb.layout_info->layout;
+				} else {
+					set_indices[num_sets_to_allocate] = i;
+					sbs[num_sets_to_allocate++] = sb;
 				}
-				vkCmdBindDescriptorSets(command_buffer,
-				                        graphics ? VK_PIPELINE_BIND_POINT_GRAPHICS : VK_PIPELINE_BIND_POINT_COMPUTE,
-				                        graphics ? current_pipeline->pipeline_layout : current_compute_pipeline->pipeline_layout,
-				                        i,
-				                        1,
-				                        &ds->descriptor_set,
-				                        0,
-				                        nullptr);
-				set_layouts_used[i] = ds->layout_info.layout;
 			} else {
-				vkCmdBindDescriptorSets(command_buffer,
-				                        graphics ? VK_PIPELINE_BIND_POINT_GRAPHICS : VK_PIPELINE_BIND_POINT_COMPUTE,
-				                        graphics ? current_pipeline->pipeline_layout : current_compute_pipeline->pipeline_layout,
-				                        i,
-				                        1,
-				                        &persistent_sets[i].first,
-				                        0,
-				                        nullptr);
+				// no dynamic offsets are supplied for persistent sets
+				assert(set_bindings[i].layout_info->descriptor_counts[(size_t)DescriptorType::eUniformBufferDynamic] == 0 &&
+				       set_bindings[i].layout_info->descriptor_counts[(size_t)DescriptorType::eStorageBufferDynamic] == 0 &&
+				       "Persistent sets can't be bound to a set layout with dynamic buffer bindings.");
+				sets_to_bind_now[i] = persistent_sets[i].first;
 				set_layouts_used[i] = persistent_sets[i].second;
 			}
+			bound_now.set(i);
 			set_bindings[i].used.reset();
 		}
+
+		// allocate all the dirty sets of this draw in one go
+		std::array<DescriptorSet, VUK_MAX_SETS> dss;
+		if (num_sets_to_allocate > 0) {
+			if (auto ret = allocator->allocate_descriptor_sets(std::span{ dss.data(), num_sets_to_allocate }, std::span{ sbs.data(), num_sets_to_allocate }); !ret) {
+				allocate_except.emplace(ret.error());
+				current_exception = &allocate_except.value();
+				return false;
+			}
+			for (uint32_t j = 0; j < num_sets_to_allocate; j++) {
+				sets_to_bind_now[set_indices[j]] = dss[j].descriptor_set;
+				set_layouts_used[set_indices[j]] = dss[j].layout_info.layout;
+				last_set_bindings[set_indices[j]] = sbs[j];
+				last_sets[set_indices[j]] = dss[j].descriptor_set;
+				last_set_layouts[set_indices[j]] = dss[j].layout_info.layout;
+			}
+			allocated_sets.insert(allocated_sets.end(), dss.begin(), dss.begin() + num_sets_to_allocate);
+		}
+
+		// bind runs of consecutive sets with a single call
+		for (uint32_t i = 0; i < VUK_MAX_SETS;) {
+			if (!bound_now.test(i)) {
+				i++;
+				continue;
+			}
+			uint32_t count = 1;
+			uint32_t offset_count = dynamic_offset_count[i];
+			while (i + count < VUK_MAX_SETS && bound_now.test(i + count)) {
+				offset_count += dynamic_offset_count[i + count];
+				count++;
+			}
+			vkCmdBindDescriptorSets(command_buffer,
+			                        graphics ? VK_PIPELINE_BIND_POINT_GRAPHICS : VK_PIPELINE_BIND_POINT_COMPUTE,
+			                        graphics ? current_pipeline->pipeline_layout : current_compute_pipeline->pipeline_layout,
+			                        i,
+			                        count,
+			                        &sets_to_bind_now[i],
+			                        offset_count,
+			                        offset_count > 0 ? &dynamic_offsets[dynamic_offset_begin[i]] : nullptr);
+			i += count;
+		}
 		auto sets_bound = sets_to_bind | persistent_sets_to_bind;            // these sets we bound freshly, valid
 		for (unsigned i = lowest_disturbed_binding; i < VUK_MAX_SETS; i++) { // clear the slots where the binding was disturbed
 			sets_used.set(i, false);
@@ -26,6 +26,7 @@
 #include "vuk/Program.hpp"
 #include "vuk/Query.hpp"
 #include "vuk/RenderGraph.hpp"
+#include "vuk/Tracing.hpp"
 
 namespace vuk {
 	Context::Context(ContextCreateParameters params) :
@@ -619,6 +620,46 @@ namespace vuk {
 		collect(impl->frame_counter);
 	}
 
+	void Context::add_awaiter(DomainFlagBits domain, uint64_t value, std::coroutine_handle<> handle) {
+		std::scoped_lock _(impl->awaiters_lock);
+		impl->awaiters.push_back({ domain, value, handle });
+	}
+
+	size_t Context::poll_awaiters() {
+		std::vector<std::coroutine_handle<>> ready;
+		{
+			std::scoped_lock _(impl->awaiters_lock);
+			// query each queue timeline at most once
+			std::array<std::pair<VkSemaphore, uint64_t>, 3> values;
+			size_t value_count = 0;
+			auto current_value = [&](DomainFlagBits domain) {
+				auto semaphore = domain_to_queue(domain).get_submit_sync().semaphore;
+				for (size_t i = 0; i < value_count; i++) {
+					if (values[i].first == semaphore) {
+						return values[i].second;
+					}
+				}
+				uint64_t value = 0;
+				vkGetSemaphoreCounterValue(device, semaphore, &value);
+				values[value_count++] = { semaphore, value };
+				return value;
+			};
+			std::erase_if(impl->awaiters, [&](const ContextImpl::Awaiter& a) {
+				if (current_value(a.domain) < a.value) {
+					return false;
+				}
+				ready.push_back(a.handle);
+				return true;
+			});
+		}
+		// resumed coroutines may add new awaiters
+		for (auto& handle : ready) {
+			handle.resume();
+		}
+		std::scoped_lock _(impl->awaiters_lock);
+		return impl->awaiters.size();
+	}
+
 	void Context::wait_idle() {
 		std::unique_lock<std::recursive_mutex> graphics_lock;
 		if (dedicated_graphics_queue) {
@@ -702,6 +743,10 @@ namespace vuk {
 		return impl->legacy_gpu_allocator.get_allocation_size(buf);
 	}
 
+	const VkPhysicalDeviceProperties& Context::get_physical_device_properties() const {
+		return impl->physical_device_properties;
+	}
+
 	RGImage Context::create(const create_info_t<RGImage>& cinfo) {
 		RGImage res{};
 		res.image = impl->legacy_gpu_allocator.create_image_for_rendertarget(cinfo.ici);
@@ -1033,10 +1078,12 @@ namespace vuk {
 	}
 
 	PipelineInfo Context::acquire_pipeline(const PipelineInstanceCreateInfo& pici, uint64_t absolute_frame) {
+		VUK_TRACE_SCOPE("Context::acquire_pipeline");
 		return impl->pipeline_cache.acquire(pici, absolute_frame);
 	}
 
 	ComputePipelineInfo Context::acquire_pipeline(const ComputePipelineInstanceCreateInfo& pici, uint64_t absolute_frame) {
+		VUK_TRACE_SCOPE("Context::acquire_pipeline");
 		return impl->compute_pipeline_cache.acquire(pici, absolute_frame);
 	}
 
@@ -1071,10 +1118,34 @@ namespace vuk {
 		return ns * 1e-9;
 	}
 
+	std::vector<std::pair<Name, double>> Context::retrieve_pass_durations(std::span<const PassTiming> timings) {
+		std::vector<std::pair<Name, double>> durations;
+		std::scoped_lock _(impl->query_lock);
+		auto& map = impl->timestamp_result_map;
+		for (auto& t : timings) {
+			auto start = map.find(t.start);
+			auto end = map.find(t.end);
+			if (start == map.end() || end == map.end()) {
+				continue;
+			}
+			auto ns = impl->physical_device_properties.limits.timestampPeriod * (end->second - start->second);
+			durations.emplace_back(t.pass, ns * 1e-9);
+			map.erase(start);
+			map.erase(t.end);
+		}
+		return durations;
+	}
+
 	Result<void> Context::make_timestamp_results_available(std::span<const TimestampQueryPool> pools) {
 		std::scoped_lock _(impl->query_lock);
 		std::array<uint64_t, TimestampQueryPool::num_queries> host_values;
 
+		size_t total_count = 0;
+		for (auto& pool : pools) {
+			total_count += pool.count;
+		}
+		impl->timestamp_result_map.reserve(impl->timestamp_result_map.size() + total_count);
+
 		for (auto& pool : pools) {
 			if (pool.count == 0) {
 				continue;
@@ -52,6 +52,14 @@ namespace vuk {
 		std::mutex query_lock;
 		robin_hood::unordered_map<Query, uint64_t> timestamp_result_map;
 
+		struct Awaiter {
+			DomainFlagBits domain;
+			uint64_t value;
+			std::coroutine_handle<> handle;
+		};
+		std::mutex awaiters_lock;
+		std::vector<Awaiter> awaiters;
+
 		void collect(uint64_t absolute_frame) {
 			transient_images.collect(absolute_frame, 6);
 			// collect rarer resources
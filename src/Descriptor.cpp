@@ -1,18 +1,72 @@
 #include "vuk/Descriptor.hpp"
 #include "vuk/Context.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <concurrentqueue.h>
+#include <memory>
 #include <mutex>
 #include <robin_hood.h>
 
 namespace vuk {
+	static std::atomic<uint64_t> descriptor_pool_id_counter = 0;
+
+	// per-thread free list in front of the shared queue - sets move between the two in batches of thread_cache_batch_size
+	struct ThreadSetCache {
+		std::vector<VkDescriptorSet> sets;
+		std::atomic<bool> dead = false;
+	};
+
 	struct DescriptorPoolImpl {
 		std::mutex grow_mutex;
 		std::vector<VkDescriptorPool> pools;
 		uint32_t sets_allocated = 0;
 		moodycamel::ConcurrentQueue<VkDescriptorSet> free_sets{ 1024 };
+		// ids are never reused, so a thread cache of a destroyed pool can't be mistaken for a live one
+		uint64_t id = descriptor_pool_id_counter++;
+		// the thread caches of every thread that used this pool, so that they can be emptied when the pool goes away
+		std::mutex thread_caches_mutex;
+		std::vector<std::shared_ptr<ThreadSetCache>> thread_caches;
+
+		void drop_thread_caches() {
+			std::lock_guard _(thread_caches_mutex);
+			for (auto& c : thread_caches) {
+				c->sets.clear();
+				c->sets.shrink_to_fit();
+				c->dead = true;
+			}
+			thread_caches.clear();
+		}
+
+		~DescriptorPoolImpl() {
+			drop_thread_caches();
+		}
 	};
 
+	static constexpr size_t thread_cache_batch_size = 32;
+	static thread_local robin_hood::unordered_node_map<uint64_t, std::shared_ptr<ThreadSetCache>> thread_set_caches;
+
+	static std::vector<VkDescriptorSet>& get_thread_cache(DescriptorPoolImpl& impl) {
+		auto it = thread_set_caches.find(impl.id);
+		if (it != thread_set_caches.end()) {
+			return it->second->sets;
+		}
+		// first use of this pool on this thread - forget the caches of destroyed pools and register a new one
+		for (auto cit = thread_set_caches.begin(); cit != thread_set_caches.end();) {
+			if (cit->second->dead) {
+				cit = thread_set_caches.erase(cit);
+			} else {
+				++cit;
+			}
+		}
+		auto cache = std::make_shared<ThreadSetCache>();
+		{
+			std::lock_guard _(impl.thread_caches_mutex);
+			impl.thread_caches.push_back(cache);
+		}
+		return thread_set_caches.emplace(impl.id, std::move(cache)).first->second->sets;
+	}
+
 	DescriptorPool::DescriptorPool() : impl(new DescriptorPoolImpl) {}
 	DescriptorPool::~DescriptorPool() {
 		delete impl;
@@ -26,7 +80,7 @@ namespace vuk {
 		o.impl = nullptr;
 	}
 
-	void DescriptorPool::grow(Context& ctx, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info) {
+	void DescriptorPool::grow(VkDevice device, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info) {
 		if (!impl->grow_mutex.try_lock())
 			return;
 		VkDescriptorPoolCreateInfo dpci{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
@@ -44,7 +98,7 @@ namespace vuk {
 		dpci.pPoolSizes = descriptor_counts.data();
 		dpci.poolSizeCount = used_idx;
 		VkDescriptorPool pool;
-		vkCreateDescriptorPool(ctx.device, &dpci, nullptr, &pool);
+		vkCreateDescriptorPool(device, &dpci, nullptr, &pool);
 		impl->pools.emplace_back(pool);
 
 		VkDescriptorSetAllocateInfo dsai{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
@@ -54,29 +108,59 @@ namespace vuk {
 		dsai.pSetLayouts = layouts.data();
 		// allocate all the descriptorsets
 		std::vector<VkDescriptorSet> sets(dsai.descriptorSetCount);
-		vkAllocateDescriptorSets(ctx.device, &dsai, sets.data());
+		vkAllocateDescriptorSets(device, &dsai, sets.data());
 		impl->free_sets.enqueue_bulk(sets.data(), sets.size());
 		impl->sets_allocated = dpci.maxSets;
 
 		impl->grow_mutex.unlock();
 	}
 
-	VkDescriptorSet DescriptorPool::acquire(Context& ctx, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info) {
+	VkDescriptorSet DescriptorPool::acquire(VkDevice device, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info) {
 		VkDescriptorSet ds;
-		while (!impl->free_sets.try_dequeue(ds)) {
-			grow(ctx, layout_alloc_info);
-		}
+		acquire(device, layout_alloc_info, std::span{ &ds, 1 });
 		return ds;
 	}
 
+	void DescriptorPool::acquire(VkDevice device, vuk::DescriptorSetLayoutAllocInfo layout_alloc_info, std::span<VkDescriptorSet> dst) {
+		auto& cache = get_thread_cache(*impl);
+		size_t acquired = 0;
+		while (acquired < dst.size()) {
+			if (cache.empty()) { // refill the thread cache from the shared queue
+				std::array<VkDescriptorSet, thread_cache_batch_size> batch;
+				size_t dequeued;
+				while ((dequeued = impl->free_sets.try_dequeue_bulk(batch.data(), batch.size())) == 0) {
+					grow(device, layout_alloc_info);
+				}
+				cache.insert(cache.end(), batch.begin(), batch.begin() + dequeued);
+			}
+			auto count = std::min(cache.size(), dst.size() - acquired);
+			std::copy(cache.end() - count, cache.end(), dst.begin() + acquired);
+			cache.resize(cache.size() - count);
+			acquired += count;
+		}
+	}
+
 	void DescriptorPool::release(VkDescriptorSet ds) {
-		impl->free_sets.enqueue(ds);
+		release(std::span{ &ds, 1 });
+	}
+
+	void DescriptorPool::release(std::span<const VkDescriptorSet> dss) {
+		auto& cache = get_thread_cache(*impl);
+		cache.insert(cache.end(), dss.begin(), dss.end());
+		// hand surplus sets back to the shared queue, so that other threads can use them
+		if (cache.size() > 2 * thread_cache_batch_size) {
+			auto surplus = cache.size() - thread_cache_batch_size;
+			impl->free_sets.enqueue_bulk(cache.data() + thread_cache_batch_size, surplus);
+			cache.resize(thread_cache_batch_size);
+		}
 	}
 
 	void DescriptorPool::destroy(VkDevice device) const {
 		for (auto& p : impl->pools) {
 			vkDestroyDescriptorPool(device, p, nullptr);
 		}
+		// the sets cached by any thread (including exited ones) died with the pools
+		impl->drop_thread_caches();
 	}
 
 	SetBinding SetBinding::finalize() {
@@ -1,66 +1,357 @@
 #include "vuk/resources/DeviceFrameResource.hpp"
 #include "../src/LegacyGPUAllocator.hpp"
+#include "Cache.hpp" // for hashing create infos
 #include "vuk/Context.hpp"
 #include "vuk/Query.hpp"
+#include "vuk/Tracing.hpp"
 #include "vuk/Descriptor.hpp"
 #include "RenderPass.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <concurrentqueue.h>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <optional>
+#include <robin_hood.h>
+#include <thread>
 
 namespace vuk {
+	// lock-free append buffer - allocations and deferred deallocations from any thread go into per-thread subqueues,
+	// the contents are drained in bulk when the frame is waited on or recycled
+	template<class T>
+	struct DeferredQueue {
+		moodycamel::ConcurrentQueue<T> queue;
+		std::vector<T> drained;
+
+		void append(std::span<const T> src) {
+			queue.enqueue_bulk(src.begin(), src.size());
+		}
+
+		void append(T value) {
+			queue.enqueue(std::move(value));
+		}
+
+		// move everything appended so far to the end of drained
+		std::vector<T>& drain() {
+			drained.reserve(drained.size() + queue.size_approx());
+			while (queue.try_dequeue_bulk(std::back_inserter(drained), 64) > 0) {
+			}
+			return drained;
+		}
+
+		// drain and hand over everything appended so far
+		std::vector<T> take() {
+			drain();
+			return std::exchange(drained, {});
+		}
+	};
+
+	// resources of a recycled frame - released either on the thread recycling the frame or on the background thread
+	struct FrameGarbage {
+		uint64_t frame;
+		std::vector<VkSemaphore> semaphores;
+		std::vector<VkFence> fences;
+		std::vector<CommandBufferAllocation> cmdbuffers;
+		std::vector<CommandPool> cmdpools;
+		std::vector<BufferGPU> buffer_gpus;
+		std::vector<BufferCrossDevice> buffer_cross_devices;
+		std::vector<VkFramebuffer> framebuffers;
+		std::vector<Image> images;
+		std::vector<std::pair<Image, ImageCreateInfo>> frame_images;
+		std::vector<ImageView> image_views;
+		std::vector<std::pair<ImageView, ImageViewCreateInfo>> frame_image_views;
+		std::vector<PersistentDescriptorSet> persistent_descriptor_sets;
+		std::vector<DescriptorSet> descriptor_sets;
+		std::vector<TimestampQueryPool> ts_query_pools;
+		std::vector<TimelineSemaphore> tsemas;
+		std::vector<VkSwapchainKHR> swapchains;
+	};
+
 	struct DeviceSuperFrameResourceImpl {
+		DeviceSuperFrameResource& sfr;
+
 		std::mutex new_frame_mutex;
 		std::atomic<uint64_t> frame_counter;
 		std::atomic<uint64_t> local_frame;
+		// number of frames cycled through, changes requested via set_frames_in_flight are applied when acquiring the next frame
+		uint64_t active_frames_in_flight;
+		std::atomic<uint64_t> requested_frames_in_flight;
 
 		std::unique_ptr<char[]> frames_storage;
 		DeviceFrameResource* frames;
+		std::vector<std::chrono::steady_clock::time_point> acquire_times;
+
+		mutable std::mutex stats_mutex;
+		FramePacingStatistics stats;
 
 		std::mutex command_pool_mutex;
 		std::array<std::vector<VkCommandPool>, 3> command_pools;
-
-		DeviceSuperFrameResourceImpl(DeviceSuperFrameResource& sfr, size_t frames_in_flight) {
+		// semaphores and fences of recycled frames, fences are kept in the unsignaled state
+		std::mutex sema_mutex;
+		std::vector<VkSemaphore> semaphores;
+		std::mutex fence_mutex;
+		std::vector<VkFence> fences;
+		// timestamp query pools of recycled frames, already reset on the host
+		std::mutex query_pool_mutex;
+		std::vector<VkQueryPool> query_pools;
+
+		// images and image views allocated from frames, recycled when the frame is recycled
+		// the pools only serve allocations from frames, as images deallocated through the super frame resource are destroyed along with their views
+		// pooled entries that have not been reused for image_recycle_age frames are destroyed
+		static constexpr uint64_t image_recycle_age = 8;
+		template<class T>
+		struct RecycledEntry {
+			T value;
+			uint64_t last_use_frame;
+		};
+		std::mutex image_pool_mutex;
+		robin_hood::unordered_node_map<ImageCreateInfo, std::vector<RecycledEntry<Image>>> image_pool;
+		robin_hood::unordered_node_map<ImageViewCreateInfo, std::vector<RecycledEntry<ImageView>>> image_view_pool;
+
+		// background deallocation
+		std::mutex worker_mutex;
+		std::condition_variable worker_cv;
+		std::deque<FrameGarbage> pending_garbage;
+		bool background_deallocation = false;
+		std::thread worker;
+
+		DeviceSuperFrameResourceImpl(DeviceSuperFrameResource& sfr, size_t frames_in_flight) :
+		    sfr(sfr),
+		    active_frames_in_flight(frames_in_flight),
+		    requested_frames_in_flight(frames_in_flight),
+		    acquire_times(frames_in_flight) {
 			frames_storage = std::unique_ptr<char[]>(new char[sizeof(DeviceFrameResource) * frames_in_flight]);
 			for (uint64_t i = 0; i < frames_in_flight; i++) {
 				new (frames_storage.get() + i * sizeof(DeviceFrameResource)) DeviceFrameResource(sfr.direct.device, sfr);
 			}
 			frames = reinterpret_cast<DeviceFrameResource*>(frames_storage.get());
 		}
+
+		// destroy pooled images and image views that were last used more than threshold frames before frame
+		void collect_images(uint64_t frame, uint64_t threshold) {
+			auto& direct = sfr.direct;
+			std::scoped_lock _(image_pool_mutex);
+			std::vector<Image> evicted_images;
+			robin_hood::unordered_flat_set<Image> evicted_image_set;
+			for (auto it = image_pool.begin(); it != image_pool.end();) {
+				auto& entries = it->second;
+				auto new_end = std::remove_if(entries.begin(), entries.end(), [&](const RecycledEntry<Image>& e) {
+					if (frame - e.last_use_frame > threshold) {
+						evicted_images.push_back(e.value);
+						evicted_image_set.insert(e.value);
+						return true;
+					}
+					return false;
+				});
+				entries.erase(new_end, entries.end());
+				if (entries.empty()) {
+					it = image_pool.erase(it);
+				} else {
+					++it;
+				}
+			}
+
+			for (auto it = image_view_pool.begin(); it != image_view_pool.end();) {
+				auto& entries = it->second;
+				// views must not outlive their image, even if they were used more recently
+				bool image_evicted = evicted_image_set.contains(it->first.image);
+				auto new_end = std::remove_if(entries.begin(), entries.end(), [&](const RecycledEntry<ImageView>& e) {
+					if (image_evicted || frame - e.last_use_frame > threshold) {
+						direct.deallocate_image_views(std::span{ &e.value, 1 });
+						return true;
+					}
+					return false;
+				});
+				entries.erase(new_end, entries.end());
+				if (entries.empty()) {
+					it = image_view_pool.erase(it);
+				} else {
+					++it;
+				}
+			}
+
+			direct.deallocate_images(evicted_images);
+		}
+
+		// allocate images for a frame, reusing pooled images where possible
+		Result<void, AllocateException> allocate_pooled_images(std::span<Image> dst, std::span<const ImageCreateInfo> cis, SourceLocationAtFrame loc) {
+			assert(dst.size() == cis.size());
+			std::unique_lock _(image_pool_mutex);
+			for (uint64_t i = 0; i < dst.size(); i++) {
+				dst[i] = VK_NULL_HANDLE;
+				auto it = image_pool.find(cis[i]);
+				if (it != image_pool.end() && it->second.size() > 0) {
+					dst[i] = it->second.back().value;
+					it->second.pop_back();
+				}
+			}
+			_.unlock();
+
+			for (uint64_t i = 0; i < dst.size(); i++) {
+				if (dst[i] != VK_NULL_HANDLE) {
+					continue;
+				}
+				auto res = sfr.direct.allocate_images(std::span{ &dst[i], 1 }, std::span{ &cis[i], 1 }, loc);
+				if (!res) {
+					// the images already handed out are unused - return them to the pool, where their pooled views stay valid
+					_.lock();
+					for (uint64_t j = 0; j < dst.size(); j++) {
+						if (dst[j] != VK_NULL_HANDLE) {
+							image_pool[cis[j]].push_back({ dst[j], frame_counter.load() });
+						}
+					}
+					return res;
+				}
+			}
+			return { expected_value };
+		}
+
+		// allocate image views for a frame, reusing pooled image views where possible
+		Result<void, AllocateException>
+		allocate_pooled_image_views(std::span<ImageView> dst, std::span<const ImageViewCreateInfo> cis, SourceLocationAtFrame loc) {
+			assert(dst.size() == cis.size());
+			std::unique_lock _(image_pool_mutex);
+			for (uint64_t i = 0; i < dst.size(); i++) {
+				dst[i] = {};
+				auto it = image_view_pool.find(cis[i]);
+				if (it != image_view_pool.end() && it->second.size() > 0) {
+					dst[i] = it->second.back().value;
+					it->second.pop_back();
+				}
+			}
+			_.unlock();
+
+			for (uint64_t i = 0; i < dst.size(); i++) {
+				if (dst[i].payload != VK_NULL_HANDLE) {
+					continue;
+				}
+				auto res = sfr.direct.allocate_image_views(std::span{ &dst[i], 1 }, std::span{ &cis[i], 1 }, loc);
+				if (!res) {
+					sfr.deallocate_image_views(dst); // pending entries are VK_NULL_HANDLE
+					return res;
+				}
+			}
+			return { expected_value };
+		}
+
+		// destroy or recycle the resources of a frame that has completed on the GPU
+		void release(FrameGarbage& g) {
+			auto& direct = sfr.direct;
+			// the frame has been waited on, so every submission using these semaphores has completed - they can be handed out again
+			{
+				std::scoped_lock _(sema_mutex);
+				semaphores.insert(semaphores.end(), g.semaphores.begin(), g.semaphores.end());
+			}
+			// fences are all signaled at this point - reset them before putting them back into the pool
+			if (g.fences.size() > 0) {
+				vkResetFences(direct.device, (uint32_t)g.fences.size(), g.fences.data());
+				std::scoped_lock _(fence_mutex);
+				fences.insert(fences.end(), g.fences.begin(), g.fences.end());
+			}
+			direct.deallocate_command_buffers(g.cmdbuffers);
+			for (auto& pool : g.cmdpools) {
+				vkResetCommandPool(direct.device, pool.command_pool, {});
+			}
+			sfr.deallocate_command_pools(g.cmdpools);
+			direct.deallocate_buffers(g.buffer_gpus);
+			direct.deallocate_buffers(g.buffer_cross_devices);
+			direct.deallocate_framebuffers(g.framebuffers);
+			direct.deallocate_images(g.images);
+			direct.deallocate_image_views(g.image_views);
+			{
+				std::scoped_lock _(image_pool_mutex);
+				robin_hood::unordered_flat_set<Image> recycled_images;
+				for (auto& [image, ici] : g.frame_images) {
+					image_pool[ici].push_back({ image, g.frame });
+					recycled_images.insert(image);
+				}
+				for (auto& [iv, ivci] : g.frame_image_views) {
+					// only views of images that are pooled can be pooled - other images might get destroyed in the meantime
+					if (recycled_images.contains(ivci.image)) {
+						image_view_pool[ivci].push_back({ iv, g.frame });
+					} else {
+						direct.deallocate_image_views(std::span{ &iv, 1 });
+					}
+				}
+			}
+			direct.deallocate_persistent_descriptor_sets(g.persistent_descriptor_sets);
+			direct.deallocate_descriptor_sets(g.descriptor_sets);
+			// the results have been read back in deallocate_frame, so the pools can be reset and handed out again
+			// pools created with a different number of queries are destroyed, as recycled pools are handed out as full-size pools
+			if (g.ts_query_pools.size() > 0) {
+				std::scoped_lock _(query_pool_mutex);
+				for (auto& p : g.ts_query_pools) {
+					if (p.capacity == TimestampQueryPool::num_queries) {
+						vkResetQueryPool(direct.device, p.pool, 0, TimestampQueryPool::num_queries);
+						query_pools.push_back(p.pool);
+					} else {
+						direct.deallocate_timestamp_query_pools(std::span{ &p, 1 });
+					}
+				}
+			}
+			direct.deallocate_timeline_semaphores(g.tsemas);
+			direct.deallocate_swapchains(g.swapchains);
+		}
+
+		void worker_loop() {
+			std::unique_lock lock(worker_mutex);
+			while (true) {
+				worker_cv.wait(lock, [this] { return !background_deallocation || !pending_garbage.empty(); });
+				if (pending_garbage.empty()) { // stopped and all work has been flushed
+					return;
+				}
+				auto garbage = std::move(pending_garbage.front());
+				pending_garbage.pop_front();
+				lock.unlock();
+				release(garbage);
+				lock.lock();
+			}
+		}
+
+		void record_statistics(std::chrono::nanoseconds wait, std::optional<std::chrono::nanoseconds> latency) {
+			std::scoped_lock _(stats_mutex);
+			// exponential moving average with a weight of 1/16 for the new sample
+			auto ema = [first = stats.frames_recycled == 0](std::chrono::nanoseconds avg, std::chrono::nanoseconds sample) {
+				return first ? sample : avg + (sample - avg) / 16;
+			};
+			stats.last_wait = wait;
+			stats.average_wait = ema(stats.average_wait, wait);
+			stats.max_wait = std::max(stats.max_wait, wait);
+			if (latency) {
+				stats.last_latency = *latency;
+				stats.average_latency = ema(stats.average_latency, *latency);
+			}
+			stats.frames_recycled++;
+		}
 	};
 
 	struct DeviceFrameResourceImpl {
-		std::mutex sema_mutex;
-		std::vector<VkSemaphore> semaphores;
-
-		std::mutex fence_mutex;
-		std::vector<VkFence> fences;
-		std::mutex cbuf_mutex;
-		std::vector<CommandBufferAllocation> cmdbuffers_to_free;
-		std::vector<CommandPool> cmdpools_to_free;
-		std::mutex framebuffer_mutex;
-		std::vector<VkFramebuffer> framebuffers;
-		std::mutex images_mutex;
-		std::vector<Image> images;
-		std::mutex image_views_mutex;
-		std::vector<ImageView> image_views;
-		std::mutex pds_mutex;
-		std::vector<PersistentDescriptorSet> persistent_descriptor_sets;
-		std::mutex ds_mutex;
-		std::vector<DescriptorSet> descriptor_sets;
+		DeferredQueue<VkSemaphore> semaphores;
+		DeferredQueue<VkFence> fences;
+		DeferredQueue<CommandBufferAllocation> cmdbuffers_to_free;
+		DeferredQueue<CommandPool> cmdpools_to_free;
+		DeferredQueue<VkFramebuffer> framebuffers;
+		DeferredQueue<Image> images;
+		DeferredQueue<std::pair<Image, ImageCreateInfo>> frame_images; // allocated from this frame, recycled
+		DeferredQueue<ImageView> image_views;
+		DeferredQueue<std::pair<ImageView, ImageViewCreateInfo>> frame_image_views; // allocated from this frame, recycled if their image is
+		DeferredQueue<PersistentDescriptorSet> persistent_descriptor_sets;
+		DeferredQueue<DescriptorSet> descriptor_sets;
 		// only for use via SuperframeAllocator
-		std::mutex buffers_mutex;
-		std::vector<BufferGPU> buffer_gpus;
-		std::vector<BufferCrossDevice> buffer_cross_devices;
+		DeferredQueue<BufferGPU> buffer_gpus;
+		DeferredQueue<BufferCrossDevice> buffer_cross_devices;
 
+		// query pools are filled in-place when allocating queries, so these remain locked
 		std::vector<TimestampQueryPool> ts_query_pools;
 		std::mutex query_pool_mutex;
 		std::mutex ts_query_mutex;
 		uint64_t query_index = 0;
-		uint64_t current_ts_pool = 0;
-		std::mutex tsema_mutex;
-		std::vector<TimelineSemaphore> tsemas;
-		std::mutex swapchain_mutex;
-		std::vector<VkSwapchainKHR> swapchains;
+		// index of the pool in ts_query_pools that on-demand queries are allocated from, if there is one in this frame
+		std::optional<uint64_t> current_ts_pool;
+		DeferredQueue<TimelineSemaphore> tsemas;
+		DeferredQueue<VkSwapchainKHR> swapchains;
 
 		LegacyLinearAllocator linear_cpu_only;
 		LegacyLinearAllocator linear_cpu_gpu;
@@ -85,9 +376,7 @@ namespace vuk {
 
 	Result<void, AllocateException> DeviceFrameResource::allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_semaphores(dst, loc));
-		std::unique_lock _(impl->sema_mutex);
-		auto& vec = impl->semaphores;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->semaphores.append(dst);
 		return { expected_value };
 	}
 
@@ -95,9 +384,7 @@ namespace vuk {
 
 	Result<void, AllocateException> DeviceFrameResource::allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_fences(dst, loc));
-		std::unique_lock _(impl->fence_mutex);
-		auto& vec = impl->fences;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->fences.append(dst);
 		return { expected_value };
 	}
 
@@ -107,9 +394,7 @@ namespace vuk {
 	                                                                              std::span<const CommandBufferAllocationCreateInfo> cis,
 	                                                                              SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_command_buffers(dst, cis, loc));
-		std::unique_lock _(impl->cbuf_mutex);
-		auto& vec = impl->cmdbuffers_to_free;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->cmdbuffers_to_free.append(dst);
 		return { expected_value };
 	}
 
@@ -118,9 +403,7 @@ namespace vuk {
 	Result<void, AllocateException>
 	DeviceFrameResource::allocate_command_pools(std::span<CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_command_pools(dst, cis, loc));
-		std::unique_lock _(impl->cbuf_mutex);
-		auto& vec = impl->cmdpools_to_free;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->cmdpools_to_free.append(dst);
 		return { expected_value };
 	}
 
@@ -177,19 +460,18 @@ namespace vuk {
 	Result<void, AllocateException>
 	DeviceFrameResource::allocate_framebuffers(std::span<VkFramebuffer> dst, std::span<const FramebufferCreateInfo> cis, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_framebuffers(dst, cis, loc));
-		std::unique_lock _(impl->framebuffer_mutex);
-		auto& vec = impl->framebuffers;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->framebuffers.append(dst);
 		return { expected_value };
 	}
 
 	void DeviceFrameResource::deallocate_framebuffers(std::span<const VkFramebuffer> src) {} // noop
 
 	Result<void, AllocateException> DeviceFrameResource::allocate_images(std::span<Image> dst, std::span<const ImageCreateInfo> cis, SourceLocationAtFrame loc) {
-		VUK_DO_OR_RETURN(upstream->allocate_images(dst, cis, loc));
-		std::unique_lock _(impl->images_mutex);
-		auto& vec = impl->images;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		auto& rf = *static_cast<DeviceSuperFrameResource*>(upstream);
+		VUK_DO_OR_RETURN(rf.impl->allocate_pooled_images(dst, cis, loc));
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			impl->frame_images.append(std::pair{ dst[i], cis[i] });
+		}
 		return { expected_value };
 	}
 
@@ -197,11 +479,11 @@ namespace vuk {
 
 	Result<void, AllocateException>
 	DeviceFrameResource::allocate_image_views(std::span<ImageView> dst, std::span<const ImageViewCreateInfo> cis, SourceLocationAtFrame loc) {
-		VUK_DO_OR_RETURN(upstream->allocate_image_views(dst, cis, loc));
-		std::unique_lock _(impl->image_views_mutex);
-
-		auto& vec = impl->image_views;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		auto& rf = *static_cast<DeviceSuperFrameResource*>(upstream);
+		VUK_DO_OR_RETURN(rf.impl->allocate_pooled_image_views(dst, cis, loc));
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			impl->frame_image_views.append(std::pair{ dst[i], cis[i] });
+		}
 		return { expected_value };
 	}
 
@@ -211,10 +493,7 @@ namespace vuk {
 	                                                                                         std::span<const PersistentDescriptorSetCreateInfo> cis,
 	                                                                                         SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_persistent_descriptor_sets(dst, cis, loc));
-		std::unique_lock _(impl->pds_mutex);
-
-		auto& vec = impl->persistent_descriptor_sets;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->persistent_descriptor_sets.append(dst);
 		return { expected_value };
 	}
 
@@ -224,10 +503,7 @@ namespace vuk {
 	DeviceFrameResource::allocate_descriptor_sets(std::span<DescriptorSet> dst, std::span<const SetBinding> cis, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_descriptor_sets(dst, cis, loc));
 
-		std::unique_lock _(impl->ds_mutex);
-
-		auto& vec = impl->descriptor_sets;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->descriptor_sets.append(dst);
 		return { expected_value };
 	}
 
@@ -255,24 +531,27 @@ namespace vuk {
 			auto& ci = cis[i];
 
 			if (ci.pool) { // use given pool to allocate query
-				ci.pool->queries[ci.pool->count++] = ci.query;
-				dst[i].id = ci.pool->count;
+				if (ci.pool->count >= TimestampQueryPool::num_queries) {
+					return { expected_error, AllocateException{ VK_ERROR_OUT_OF_POOL_MEMORY } };
+				}
+				ci.pool->queries[ci.pool->count] = ci.query;
+				dst[i].id = ci.pool->count++;
 				dst[i].pool = ci.pool->pool;
-			} else { // allocate a pool on demand
+			} else { // allocate a pool on demand - when the current pool is full, chain a new one
 				std::unique_lock _(impl->query_pool_mutex);
-				if (impl->query_index % TimestampQueryPool::num_queries == 0) {
+				auto& vec = impl->ts_query_pools;
+				if (!impl->current_ts_pool || vec[*impl->current_ts_pool].count == TimestampQueryPool::num_queries) {
 					VkQueryPoolCreateInfo qpci{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
 					qpci.queryCount = TimestampQueryPool::num_queries;
 					qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
 					TimestampQueryPool p;
 					VUK_DO_OR_RETURN(upstream->allocate_timestamp_query_pools(std::span{ &p, 1 }, std::span{ &qpci, 1 }, loc));
 
-					auto& vec = impl->ts_query_pools;
 					vec.emplace_back(p);
 					impl->current_ts_pool = vec.size() - 1;
 				}
 
-				auto& pool = impl->ts_query_pools[impl->current_ts_pool];
+				auto& pool = vec[*impl->current_ts_pool];
 				pool.queries[pool.count++] = ci.query;
 				dst[i].id = pool.count - 1;
 				dst[i].pool = pool.pool;
@@ -288,68 +567,102 @@ namespace vuk {
 
 	Result<void, AllocateException> DeviceFrameResource::allocate_timeline_semaphores(std::span<TimelineSemaphore> dst, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_timeline_semaphores(dst, loc));
-		std::unique_lock _(impl->tsema_mutex);
-
-		auto& vec = impl->tsemas;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->tsemas.append(dst);
 		return { expected_value };
 	}
 
 	void DeviceFrameResource::deallocate_timeline_semaphores(std::span<const TimelineSemaphore> src) {} // noop
 
 	void DeviceFrameResource::deallocate_swapchains(std::span<const VkSwapchainKHR> src) {
-		std::scoped_lock _(impl->swapchain_mutex);
-
-		auto& vec = impl->swapchains;
-		vec.insert(vec.end(), src.begin(), src.end());
+		impl->swapchains.append(src);
 	}
 
 	void DeviceFrameResource::wait() {
-		if (impl->fences.size() > 0) {
-			vkWaitForFences(device, (uint32_t)impl->fences.size(), impl->fences.data(), true, UINT64_MAX);
+		auto& fences = impl->fences.drain();
+		if (fences.size() > 0) {
+			vkWaitForFences(device, (uint32_t)fences.size(), fences.data(), true, UINT64_MAX);
 		}
-		if (impl->tsemas.size() > 0) {
+		auto& tsemas = impl->tsemas.drain();
+		if (tsemas.size() > 0) {
 			VkSemaphoreWaitInfo swi{ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
 
-			std::vector<VkSemaphore> semas(impl->tsemas.size());
-			std::vector<uint64_t> values(impl->tsemas.size());
+			std::vector<VkSemaphore> semas(tsemas.size());
+			std::vector<uint64_t> values(tsemas.size());
 
-			for (uint64_t i = 0; i < impl->tsemas.size(); i++) {
-				semas[i] = impl->tsemas[i].semaphore;
-				values[i] = *impl->tsemas[i].value;
+			for (uint64_t i = 0; i < tsemas.size(); i++) {
+				semas[i] = tsemas[i].semaphore;
+				values[i] = *tsemas[i].value;
 			}
 			swi.pSemaphores = semas.data();
 			swi.pValues = values.data();
-			swi.semaphoreCount = (uint32_t)impl->tsemas.size();
+			swi.semaphoreCount = (uint32_t)tsemas.size();
 			vkWaitSemaphores(device, &swi, UINT64_MAX);
 		}
 	}
 
+	bool DeviceFrameResource::is_ready() {
+		for (auto& fence : impl->fences.drain()) {
+			if (vkGetFenceStatus(device, fence) != VK_SUCCESS) {
+				return false;
+			}
+		}
+		for (auto& tsema : impl->tsemas.drain()) {
+			uint64_t value;
+			vkGetSemaphoreCounterValue(device, tsema.semaphore, &value);
+			if (value < *tsema.value) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	DeviceSuperFrameResource::DeviceSuperFrameResource(Context& ctx, uint64_t frames_in_flight) :
 	    frames_in_flight(frames_in_flight),
 	    direct(ctx, ctx.get_legacy_gpu_allocator()),
 	    impl(new DeviceSuperFrameResourceImpl(*this, frames_in_flight)) {}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) {
-		return direct.allocate_semaphores(dst, loc);
+		std::unique_lock _(impl->sema_mutex);
+		auto& source = impl->semaphores;
+		auto num_recycled = std::min(dst.size(), source.size());
+		std::copy(source.end() - num_recycled, source.end(), dst.begin());
+		source.resize(source.size() - num_recycled);
+		_.unlock();
+		if (num_recycled < dst.size()) {
+			auto res = direct.allocate_semaphores(dst.subspan(num_recycled), loc);
+			if (!res) {
+				std::unique_lock _(impl->sema_mutex);
+				source.insert(source.end(), dst.begin(), dst.begin() + num_recycled);
+				return res;
+			}
+		}
+		return { expected_value };
 	}
 
 	void DeviceSuperFrameResource::deallocate_semaphores(std::span<const VkSemaphore> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->sema_mutex);
-		auto& vec = get_last_frame().impl->semaphores;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->semaphores.append(src);
 	}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) {
-		return direct.allocate_fences(dst, loc);
+		std::unique_lock _(impl->fence_mutex);
+		auto& source = impl->fences;
+		auto num_recycled = std::min(dst.size(), source.size());
+		std::copy(source.end() - num_recycled, source.end(), dst.begin());
+		source.resize(source.size() - num_recycled);
+		_.unlock();
+		if (num_recycled < dst.size()) {
+			auto res = direct.allocate_fences(dst.subspan(num_recycled), loc);
+			if (!res) {
+				std::unique_lock _(impl->fence_mutex);
+				source.insert(source.end(), dst.begin(), dst.begin() + num_recycled);
+				return res;
+			}
+		}
+		return { expected_value };
 	}
 
 	void DeviceSuperFrameResource::deallocate_fences(std::span<const VkFence> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->fence_mutex);
-		auto& vec = f.impl->fences;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->fences.append(src);
 	}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_command_buffers(std::span<CommandBufferAllocation> dst,
@@ -359,10 +672,7 @@ namespace vuk {
 	}
 
 	void DeviceSuperFrameResource::deallocate_command_buffers(std::span<const CommandBufferAllocation> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->cbuf_mutex);
-		auto& vec = f.impl->cmdbuffers_to_free;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->cmdbuffers_to_free.append(src);
 	}
 
 	Result<void, AllocateException>
@@ -395,10 +705,7 @@ namespace vuk {
 	}
 
 	void DeviceSuperFrameResource::deallocate_buffers(std::span<const BufferCrossDevice> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->buffers_mutex);
-		auto& vec = f.impl->buffer_cross_devices;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->buffer_cross_devices.append(src);
 	}
 
 	Result<void, AllocateException>
@@ -407,10 +714,7 @@ namespace vuk {
 	}
 
 	void DeviceSuperFrameResource::deallocate_buffers(std::span<const BufferGPU> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->buffers_mutex);
-		auto& vec = f.impl->buffer_gpus;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->buffer_gpus.append(src);
 	}
 
 	Result<void, AllocateException>
@@ -419,10 +723,7 @@ namespace vuk {
 	}
 
 	void DeviceSuperFrameResource::deallocate_framebuffers(std::span<const VkFramebuffer> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->framebuffer_mutex);
-		auto& vec = f.impl->framebuffers;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->framebuffers.append(src);
 	}
 
 	Result<void, AllocateException>
@@ -431,10 +732,7 @@ namespace vuk {
 	}
 
 	void DeviceSuperFrameResource::deallocate_images(std::span<const Image> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->images_mutex);
-		auto& vec = f.impl->images;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->images.append(src);
 	}
 
 	Result<void, AllocateException>
@@ -443,10 +741,7 @@ namespace vuk {
 	}
 
 	void DeviceSuperFrameResource::deallocate_image_views(std::span<const ImageView> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->image_views_mutex);
-		auto& vec = f.impl->image_views;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->image_views.append(src);
 	}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_persistent_descriptor_sets(std::span<PersistentDescriptorSet> dst,
@@ -456,10 +751,7 @@ namespace vuk {
 	}
 
 	void DeviceSuperFrameResource::deallocate_persistent_descriptor_sets(std::span<const PersistentDescriptorSet> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->pds_mutex);
-		auto& vec = f.impl->persistent_descriptor_sets;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->persistent_descriptor_sets.append(src);
 	}
 
 	Result<void, AllocateException>
@@ -468,16 +760,31 @@ namespace vuk {
 	}
 
 	void DeviceSuperFrameResource::deallocate_descriptor_sets(std::span<const DescriptorSet> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->ds_mutex);
-		auto& vec = f.impl->descriptor_sets;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->descriptor_sets.append(src);
 	}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_timestamp_query_pools(std::span<TimestampQueryPool> dst,
 	                                                                                         std::span<const VkQueryPoolCreateInfo> cis,
 	                                                                                         SourceLocationAtFrame loc) {
-		return direct.allocate_timestamp_query_pools(dst, cis, loc);
+		assert(dst.size() == cis.size());
+		std::scoped_lock _(impl->query_pool_mutex);
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			auto& ci = cis[i];
+			// only pools of the default size are recycled
+			if (ci.queryType == VK_QUERY_TYPE_TIMESTAMP && ci.queryCount == TimestampQueryPool::num_queries && impl->query_pools.size() > 0) {
+				dst[i].pool = impl->query_pools.back();
+				dst[i].count = 0;
+				dst[i].capacity = TimestampQueryPool::num_queries;
+				impl->query_pools.pop_back();
+			} else {
+				auto result = direct.allocate_timestamp_query_pools(std::span{ &dst[i], 1 }, std::span{ &ci, 1 }, loc);
+				if (!result) {
+					deallocate_timestamp_query_pools(dst.subspan(0, i));
+					return result;
+				}
+			}
+		}
+		return { expected_value };
 	}
 
 	void DeviceSuperFrameResource::deallocate_timestamp_query_pools(std::span<const TimestampQueryPool> src) {
@@ -500,81 +807,154 @@ namespace vuk {
 	}
 
 	void DeviceSuperFrameResource::deallocate_timeline_semaphores(std::span<const TimelineSemaphore> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->tsema_mutex);
-		auto& vec = f.impl->tsemas;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->tsemas.append(src);
 	}
 
 	void DeviceSuperFrameResource::deallocate_swapchains(std::span<const VkSwapchainKHR> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->swapchain_mutex);
-		auto& vec = f.impl->swapchains;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->swapchains.append(src);
 	}
 
 	DeviceFrameResource& DeviceSuperFrameResource::get_last_frame() {
-		return impl->frames[impl->frame_counter.load() % frames_in_flight];
+		return impl->frames[impl->local_frame.load()];
 	}
 
 	DeviceFrameResource& DeviceSuperFrameResource::get_next_frame() {
+		VUK_TRACE_SCOPE("DeviceSuperFrameResource::get_next_frame");
 		std::unique_lock _(impl->new_frame_mutex);
+		return *acquire_next_frame(true);
+	}
 
-		impl->frame_counter++;
-		impl->local_frame = impl->frame_counter % frames_in_flight;
+	DeviceFrameResource* DeviceSuperFrameResource::try_get_next_frame() {
+		std::unique_lock _(impl->new_frame_mutex, std::try_to_lock);
+		if (!_) {
+			return nullptr;
+		}
+		return acquire_next_frame(false);
+	}
+
+	DeviceFrameResource* DeviceSuperFrameResource::acquire_next_frame(bool block) {
+		auto old_frames_in_flight = impl->active_frames_in_flight;
+		auto new_frames_in_flight = impl->requested_frames_in_flight.load();
+		auto next_frame = impl->frame_counter.load() + 1;
+		// continue from the current frame rather than from next_frame % new_frames_in_flight - after a change in the number of frames
+		// the latter can land on the frame that was just handed out
+		auto next_local_frame = (impl->local_frame.load() + 1) % new_frames_in_flight;
+
+		auto& f = impl->frames[next_local_frame];
+		if (!block) {
+			// frames dropped by lowering the number of frames in flight are recycled here too
+			for (uint64_t i = new_frames_in_flight; i < old_frames_in_flight; i++) {
+				if (!impl->frames[i].is_ready()) {
+					return nullptr;
+				}
+			}
+			if (!f.is_ready()) {
+				return nullptr;
+			}
+		}
 
-		auto& f = impl->frames[impl->local_frame];
+		auto wait_start = std::chrono::steady_clock::now();
+		for (uint64_t i = new_frames_in_flight; i < old_frames_in_flight; i++) {
+			impl->frames[i].wait();
+			deallocate_frame(impl->frames[i]);
+		}
 		f.wait();
+		auto wait_end = std::chrono::steady_clock::now();
+		std::optional<std::chrono::nanoseconds> latency;
+		if (f.current_frame != (uint64_t)-1) {
+			latency = wait_end - impl->acquire_times[next_local_frame];
+		}
+		impl->record_statistics(wait_end - wait_start, latency);
+
 		deallocate_frame(f);
-		f.current_frame = impl->frame_counter.load();
+		impl->active_frames_in_flight = new_frames_in_flight;
+		impl->frame_counter = next_frame;
+		impl->local_frame = next_local_frame;
+		impl->collect_images(next_frame, DeviceSuperFrameResourceImpl::image_recycle_age);
+
+		impl->acquire_times[next_local_frame] = std::chrono::steady_clock::now();
+		f.current_frame = next_frame;
+
+		return &f;
+	}
 
-		return f;
+	void DeviceSuperFrameResource::set_frames_in_flight(uint64_t count) {
+		assert(count > 0 && count <= frames_in_flight);
+		impl->requested_frames_in_flight = count;
+	}
+
+	uint64_t DeviceSuperFrameResource::get_frames_in_flight() const {
+		return impl->requested_frames_in_flight.load();
+	}
+
+	FramePacingStatistics DeviceSuperFrameResource::get_pacing_statistics() const {
+		std::scoped_lock _(impl->stats_mutex);
+		return impl->stats;
+	}
+
+	void DeviceSuperFrameResource::set_background_deallocation(bool enable) {
+		std::unique_lock lock(impl->worker_mutex);
+		if (enable == impl->background_deallocation) {
+			return;
+		}
+		impl->background_deallocation = enable;
+		if (enable) {
+			impl->worker = std::thread(&DeviceSuperFrameResourceImpl::worker_loop, impl);
+		} else {
+			// the worker flushes the pending frames before exiting
+			lock.unlock();
+			impl->worker_cv.notify_one();
+			impl->worker.join();
+		}
 	}
 
 	void DeviceSuperFrameResource::deallocate_frame(DeviceFrameResource& frame) {
 		auto& f = *frame.impl;
-		direct.deallocate_semaphores(f.semaphores);
-		direct.deallocate_fences(f.fences);
-		direct.deallocate_command_buffers(f.cmdbuffers_to_free);
-		for (auto& pool : f.cmdpools_to_free) {
-			vkResetCommandPool(direct.device, pool.command_pool, {});
-		}
-		deallocate_command_pools(f.cmdpools_to_free);
-		direct.deallocate_buffers(f.buffer_gpus);
-		direct.deallocate_buffers(f.buffer_cross_devices);
-		direct.deallocate_framebuffers(f.framebuffers);
-		direct.deallocate_images(f.images);
-		direct.deallocate_image_views(f.image_views);
-		direct.deallocate_persistent_descriptor_sets(f.persistent_descriptor_sets);
-		direct.deallocate_descriptor_sets(f.descriptor_sets);
-		direct.ctx->make_timestamp_results_available(f.ts_query_pools);
-		direct.deallocate_timestamp_query_pools(f.ts_query_pools);
-		direct.deallocate_timeline_semaphores(f.tsemas);
-		direct.deallocate_swapchains(f.swapchains);
-
-		f.semaphores.clear();
-		f.fences.clear();
-		f.buffer_cross_devices.clear();
-		f.buffer_gpus.clear();
-		f.cmdbuffers_to_free.clear();
-		f.cmdpools_to_free.clear();
+		FrameGarbage garbage{ .frame = impl->frame_counter.load() };
+		garbage.semaphores = f.semaphores.take();
+		garbage.fences = f.fences.take();
+		garbage.cmdbuffers = f.cmdbuffers_to_free.take();
+		garbage.cmdpools = f.cmdpools_to_free.take();
+		garbage.buffer_gpus = f.buffer_gpus.take();
+		garbage.buffer_cross_devices = f.buffer_cross_devices.take();
+		garbage.framebuffers = f.framebuffers.take();
+		garbage.images = f.images.take();
+		garbage.frame_images = f.frame_images.take();
+		garbage.image_views = f.image_views.take();
+		garbage.frame_image_views = f.frame_image_views.take();
+		garbage.persistent_descriptor_sets = f.persistent_descriptor_sets.take();
+		garbage.descriptor_sets = f.descriptor_sets.take();
+		garbage.tsemas = f.tsemas.take();
+		garbage.swapchains = f.swapchains.take();
+		{
+			// results are made available right away, so that they can be queried after acquiring the next frame
+			std::scoped_lock _(f.query_pool_mutex);
+			direct.ctx->make_timestamp_results_available(f.ts_query_pools);
+			garbage.ts_query_pools = std::exchange(f.ts_query_pools, {});
+			f.query_index = 0;
+			f.current_ts_pool.reset();
+		}
+
+		// the linear allocators are reused by the frame, so they must be reset before handing it out again
 		auto& legacy = direct.legacy_gpu_allocator;
 		legacy->reset_pool(f.linear_cpu_only);
 		legacy->reset_pool(f.linear_cpu_gpu);
 		legacy->reset_pool(f.linear_gpu_cpu);
 		legacy->reset_pool(f.linear_gpu_only);
-		f.framebuffers.clear();
-		f.images.clear();
-		f.image_views.clear();
-		f.persistent_descriptor_sets.clear();
-		f.descriptor_sets.clear();
-		f.ts_query_pools.clear();
-		f.query_index = 0;
-		f.tsemas.clear();
-		f.swapchains.clear();
+
+		std::unique_lock lock(impl->worker_mutex);
+		if (impl->background_deallocation) {
+			impl->pending_garbage.emplace_back(std::move(garbage));
+			lock.unlock();
+			impl->worker_cv.notify_one();
+		} else {
+			lock.unlock();
+			impl->release(garbage);
+		}
 	}
 
 	DeviceSuperFrameResource::~DeviceSuperFrameResource() {
+		set_background_deallocation(false);
 		for (auto i = 0; i < frames_in_flight; i++) {
 			auto lframe = (impl->frame_counter + i) % frames_in_flight;
 			auto& f = impl->frames[lframe];
@@ -592,6 +972,22 @@ namespace vuk {
 				direct.deallocate_command_pools(std::span{ &p, 1 });
 			}
 		}
+		direct.deallocate_semaphores(impl->semaphores);
+		direct.deallocate_fences(impl->fences);
+		for (auto& qp : impl->query_pools) {
+			TimestampQueryPool p{ qp };
+			direct.deallocate_timestamp_query_pools(std::span{ &p, 1 });
+		}
+		for (auto& [ivci, entries] : impl->image_view_pool) {
+			for (auto& e : entries) {
+				direct.deallocate_image_views(std::span{ &e.value, 1 });
+			}
+		}
+		for (auto& [ici, entries] : impl->image_pool) {
+			for (auto& e : entries) {
+				direct.deallocate_images(std::span{ &e.value, 1 });
+			}
+		}
 		delete impl;
 	}
-} // namespace vuk
\ No newline at end of file
+} // namespace vuk
@@ -55,27 +55,46 @@ namespace vuk {
 	                                                                           SourceLocationAtFrame loc) {
 		assert(dst.size() == cis.size());
 
-		for (uint64_t i = 0; i < dst.size(); i++) {
+		// consecutive command buffers from the same pool and of the same level are allocated with a single call
+		std::array<VkCommandBuffer, 32> cbufs;
+		for (uint64_t i = 0; i < dst.size();) {
 			auto& ci = cis[i];
+			uint64_t count = 1;
+			while (count < cbufs.size() && i + count < dst.size() && cis[i + count].command_pool == ci.command_pool && cis[i + count].level == ci.level) {
+				count++;
+			}
 
 			VkCommandBufferAllocateInfo cbai{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-			cbai.commandBufferCount = 1;
+			cbai.commandBufferCount = (uint32_t)count;
 			cbai.commandPool = ci.command_pool.command_pool;
 			cbai.level = ci.level;
 
-			VkResult res = vkAllocateCommandBuffers(device, &cbai, &dst[i].command_buffer);
+			VkResult res = vkAllocateCommandBuffers(device, &cbai, cbufs.data());
 			if (res != VK_SUCCESS) {
+				deallocate_command_buffers({ dst.data(), i });
 				return { expected_error, AllocateException{ res } };
 			}
-			dst[i].command_pool = ci.command_pool;
+			for (uint64_t j = 0; j < count; j++) {
+				dst[i + j] = { cbufs[j], ci.command_pool };
+			}
+			i += count;
 		}
 
 		return { expected_value };
 	}
 
 	void DeviceVkResource::deallocate_command_buffers(std::span<const CommandBufferAllocation> dst) {
-		for (auto& c : dst) {
-			vkFreeCommandBuffers(device, c.command_pool.command_pool, 1, &c.command_buffer);
+		// consecutive command buffers from the same pool are freed with a single call
+		std::array<VkCommandBuffer, 32> cbufs;
+		for (uint64_t i = 0; i < dst.size();) {
+			auto& pool = dst[i].command_pool;
+			uint64_t count = 0;
+			while (count < cbufs.size() && i + count < dst.size() && dst[i + count].command_pool == pool) {
+				cbufs[count] = dst[i + count].command_buffer;
+				count++;
+			}
+			vkFreeCommandBuffers(device, pool.command_pool, (uint32_t)count, cbufs.data());
+			i += count;
 		}
 	}
 
@@ -190,7 +209,7 @@ namespace vuk {
 	DeviceVkResource::allocate_image_views(std::span<ImageView> dst, std::span<const ImageViewCreateInfo> cis, SourceLocationAtFrame loc) {
 		assert(dst.size() == cis.size());
 		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
-			VkImageViewCreateInfo ci = cis[i];
+			const VkImageViewCreateInfo& ci = cis[i];
 			VkImageView iv;
 			VkResult res = vkCreateImageView(device, &ci, nullptr, &iv);
 			if (res != VK_SUCCESS) {
@@ -281,52 +300,92 @@ namespace vuk {
 	Result<void, AllocateException>
 	DeviceVkResource::allocate_descriptor_sets(std::span<DescriptorSet> dst, std::span<const SetBinding> cis, SourceLocationAtFrame loc) {
 		assert(dst.size() == cis.size());
-		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
-			auto& cinfo = cis[i];
-			auto& pool = ctx->acquire_descriptor_pool(*cinfo.layout_info, ctx->get_frame_count());
-			auto ds = pool.acquire(*ctx, *cinfo.layout_info);
-			auto mask = cinfo.used.to_ulong();
-			uint32_t leading_ones = num_leading_ones(mask);
-			std::array<VkWriteDescriptorSet, VUK_MAX_BINDINGS> writes = {};
-			int j = 0;
-			for (uint32_t i = 0; i < leading_ones; i++, j++) {
-				if (!cinfo.used.test(i)) {
-					j--;
+		// sets are processed in batches - sets of a batch sharing a layout are acquired from their pool together,
+		// and the whole batch is written with a single update
+		constexpr uint64_t batch_size = VUK_MAX_SETS;
+		std::array<VkDescriptorSet, batch_size> sets;
+		std::array<VkDescriptorSet, batch_size> group_sets;
+		std::array<uint64_t, batch_size> group;
+		std::array<VkWriteDescriptorSet, batch_size * VUK_MAX_BINDINGS> writes;
+		for (uint64_t base = 0; base < dst.size(); base += batch_size) {
+			auto count = std::min(batch_size, dst.size() - base);
+			auto batch = cis.subspan(base, count);
+
+			std::bitset<batch_size> acquired;
+			for (uint64_t i = 0; i < count; i++) {
+				if (acquired.test(i)) {
 					continue;
 				}
-				auto& write = writes[j];
-				write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
-				auto& binding = cinfo.bindings[i];
-				write.descriptorType = (VkDescriptorType)binding.type;
-				write.dstArrayElement = 0;
-				write.descriptorCount = 1;
-				write.dstBinding = i;
-				write.dstSet = ds;
-				switch (binding.type) {
-				case DescriptorType::eUniformBuffer:
-				case DescriptorType::eStorageBuffer:
-					write.pBufferInfo = &binding.buffer;
-					break;
-				case DescriptorType::eSampledImage:
-				case DescriptorType::eSampler:
-				case DescriptorType::eCombinedImageSampler:
-				case DescriptorType::eStorageImage:
-					write.pImageInfo = &binding.image.dii;
-					break;
-				default:
-					assert(0);
+				auto& layout_info = *batch[i].layout_info;
+				uint64_t group_count = 0;
+				for (uint64_t j = i; j < count; j++) {
+					if (!acquired.test(j) && batch[j].layout_info->layout == layout_info.layout) {
+						group[group_count++] = j;
+						acquired.set(j);
+					}
+				}
+				auto& pool = ctx->acquire_descriptor_pool(layout_info, ctx->get_frame_count());
+				pool.acquire(device, layout_info, std::span{ group_sets.data(), group_count });
+				for (uint64_t j = 0; j < group_count; j++) {
+					sets[group[j]] = group_sets[j];
 				}
 			}
-			vkUpdateDescriptorSets(device, j, writes.data(), 0, nullptr);
-			dst[i] = { ds, *cinfo.layout_info };
+
+			uint32_t write_count = 0;
+			for (uint64_t i = 0; i < count; i++) {
+				auto& cinfo = batch[i];
+				auto ds = sets[i];
+				auto mask = cinfo.used.to_ulong();
+				uint32_t leading_ones = num_leading_ones(mask);
+				for (uint32_t j = 0; j < leading_ones; j++) {
+					if (!cinfo.used.test(j)) {
+						continue;
+					}
+					auto& write = writes[write_count++];
+					write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+					auto& binding = cinfo.bindings[j];
+					write.descriptorType = (VkDescriptorType)binding.type;
+					write.dstArrayElement = 0;
+					write.descriptorCount = 1;
+					write.dstBinding = j;
+					write.dstSet = ds;
+					switch (binding.type) {
+					case DescriptorType::eUniformBuffer:
+					case DescriptorType::eStorageBuffer:
+					case DescriptorType::eUniformBufferDynamic:
+					case DescriptorType::eStorageBufferDynamic:
+						write.pBufferInfo = &binding.buffer;
+						break;
+					case DescriptorType::eSampledImage:
+					case DescriptorType::eSampler:
+					case DescriptorType::eCombinedImageSampler:
+					case DescriptorType::eStorageImage:
+						write.pImageInfo = &binding.image.dii;
+						break;
+					default:
+						assert(0);
+					}
+				}
+				dst[base + i] = { ds, *cinfo.layout_info };
+			}
+			vkUpdateDescriptorSets(device, write_count, writes.data(), 0, nullptr);
 		}
 		return { expected_value };
 	}
 
 	void DeviceVkResource::deallocate_descriptor_sets(std::span<const DescriptorSet> src) {
-		for (int64_t i = 0; i < (int64_t)src.size(); i++) {
-			DescriptorPool& pool = ctx->acquire_descriptor_pool(src[i].layout_info, ctx->get_frame_count());
-			pool.release(src[i].descriptor_set);
+		// consecutive sets with the same layout are returned to their pool together
+		std::array<VkDescriptorSet, VUK_MAX_SETS> sets;
+		for (uint64_t i = 0; i < src.size();) {
+			auto& layout_info = src[i].layout_info;
+			uint64_t count = 0;
+			while (count < sets.size() && i + count < src.size() && src[i + count].layout_info.layout == layout_info.layout) {
+				sets[count] = src[i + count].descriptor_set;
+				count++;
+			}
+			DescriptorPool& pool = ctx->acquire_descriptor_pool(layout_info, ctx->get_frame_count());
+			pool.release(std::span{ sets.data(), count });
+			i += count;
 		}
 	}
 
@@ -348,6 +407,8 @@ namespace vuk {
 				return { expected_error, AllocateException{ res } };
 			}
 			vkResetQueryPool(device, dst[i].pool, 0, cis[i].queryCount);
+			dst[i].count = 0;
+			dst[i].capacity = cis[i].queryCount;
 		}
 		return { expected_value };
 	}
@@ -367,8 +428,12 @@ namespace vuk {
 		for (uint64_t i = 0; i < dst.size(); i++) {
 			auto& ci = cis[i];
 
-			ci.pool->queries[ci.pool->count++] = ci.query;
-			dst[i].id = ci.pool->count;
+			// the pool is provided by DeviceFrameResource, allocating from elsewhere can't place the query
+			if (!ci.pool || ci.pool->count >= TimestampQueryPool::num_queries) {
+				return { expected_error, AllocateException{ VK_ERROR_OUT_OF_POOL_MEMORY } };
+			}
+			ci.pool->queries[ci.pool->count] = ci.query;
+			dst[i].id = ci.pool->count++;
 			dst[i].pool = ci.pool->pool;
 		}
 
@@ -378,12 +443,12 @@ namespace vuk {
 	void DeviceVkResource::deallocate_timestamp_queries(std::span<const TimestampQuery> src) {}
 
 	Result<void, AllocateException> DeviceVkResource::allocate_timeline_semaphores(std::span<TimelineSemaphore> dst, SourceLocationAtFrame loc) {
+		VkSemaphoreCreateInfo sci{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+		VkSemaphoreTypeCreateInfo stci{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+		stci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		stci.initialValue = 0;
+		sci.pNext = &stci;
 		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
-			VkSemaphoreCreateInfo sci{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-			VkSemaphoreTypeCreateInfo stci{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
-			stci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
-			stci.initialValue = 0;
-			sci.pNext = &stci;
 			VkResult res = vkCreateSemaphore(device, &sci, nullptr, &dst[i].semaphore);
 			if (res != VK_SUCCESS) {
 				deallocate_timeline_semaphores({ dst.data(), (uint64_t)i });
@@ -5,6 +5,8 @@
 #include "vuk/Future.hpp"
 #include "vuk/Hash.hpp" // for create
 #include "vuk/RenderGraph.hpp"
+#include "vuk/Tracing.hpp"
+#include "vuk/resources/DeviceFrameResource.hpp"
 #include <unordered_set>
 
 namespace vuk {
@@ -116,6 +118,7 @@ namespace vuk {
 	}
 
 	Result<SubmitInfo> ExecutableRenderGraph::record_single_submit(Allocator& alloc, std::span<RenderPassInfo> rpis, vuk::DomainFlagBits domain) {
+		VUK_TRACE_SCOPE("ExecutableRenderGraph::record_single_submit");
 		assert(rpis.size() > 0);
 
 		auto& ctx = alloc.get_context();
@@ -159,11 +162,11 @@ namespace vuk {
 			bool use_secondary_command_buffers = rpass.subpasses[0].use_secondary_command_buffers;
 			bool is_single_pass = rpass.subpasses.size() == 1 && rpass.subpasses[0].passes.size() == 1;
 			if (is_single_pass && !rpass.subpasses[0].passes[0]->pass.name.is_invalid() && rpass.subpasses[0].passes[0]->pass.execute) {
-				ctx.debug.begin_region(cbuf, rpass.subpasses[0].passes[0]->pass.name);
+				ctx.debug.begin_region(cbuf, rpass.subpasses[0].passes[0]->display_name);
 			}
 
 			for (auto dep : rpass.pre_barriers) {
-				auto& bound = impl->bound_attachments[dep.image];
+				auto& bound = impl->bound_attachments.at(dep.image);
 				dep.barrier.image = bound.attachment.image;
 				// turn base_{layer, level} into absolute values wrt the image
 				dep.barrier.subresourceRange.baseArrayLayer += bound.attachment.base_layer;
@@ -193,7 +196,7 @@ namespace vuk {
 				// insert image pre-barriers
 				if (rpass.handle == VK_NULL_HANDLE) {
 					for (auto dep : sp.pre_barriers) {
-						dep.barrier.image = impl->bound_attachments[dep.image].attachment.image;
+						dep.barrier.image = impl->bound_attachments.at(dep.image).attachment.image;
 						vkCmdPipelineBarrier(cbuf, (VkPipelineStageFlags)dep.src, (VkPipelineStageFlags)dep.dst, 0, 0, nullptr, 0, nullptr, 1, &dep.barrier);
 					}
 					for (const auto& dep : sp.pre_mem_barriers) {
@@ -203,28 +206,44 @@ namespace vuk {
 				for (auto& p : sp.passes) {
 					CommandBuffer cobuf(*this, ctx, alloc, cbuf);
 					fill_renderpass_info(rpass, i, cobuf);
+					// timestamps can't be written into the primary command buffer while in a subpass with secondary contents
+					// passes that are wrapped into a secondary command buffer write them there, passes recording their own are not timed
+					auto timing = p->timing_index ? &impl->pass_timings[*p->timing_index] : nullptr;
+					bool wrapped_in_secondary = p->pass.use_secondary_command_buffers == false && use_secondary_command_buffers == true;
+					bool timestamps_in_primary = timing && !wrapped_in_secondary && (!use_secondary_command_buffers || rpass.handle == VK_NULL_HANDLE);
+					assert((!timing || wrapped_in_secondary || timestamps_in_primary) && "Pass timed, but its timestamps can't be written.");
+					if (timestamps_in_primary) {
+						cobuf.write_timestamp(timing->start, PipelineStageFlagBits::eTopOfPipe);
+					}
 					// propagate waits & signals onto SI
 					if (p->pass.signal) {
 						si.future_signals.emplace_back(p->pass.signal);
 					}
+					si.absolute_waits.insert(si.absolute_waits.end(), p->absolute_waits.begin(), p->absolute_waits.end());
 
 					// if pass requested no secondary cbufs, but due to subpass merging that is what we got
-					if (p->pass.use_secondary_command_buffers == false && use_secondary_command_buffers == true) {
+					if (wrapped_in_secondary) {
 						auto res = cobuf.begin_secondary();
 						if (!res) {
 							return { expected_error, res.error() };
 						}
 						auto secondary = *res;
+						if (timing) {
+							secondary.write_timestamp(timing->start, PipelineStageFlagBits::eTopOfPipe);
+						}
 						if (p->pass.execute) {
 							secondary.current_pass = p;
 							if (!p->pass.name.is_invalid() && !is_single_pass) {
-								ctx.debug.begin_region(cobuf.command_buffer, p->pass.name);
+								ctx.debug.begin_region(cobuf.command_buffer, p->display_name);
 								p->pass.execute(secondary);
 								ctx.debug.end_region(cobuf.command_buffer);
 							} else {
 								p->pass.execute(secondary);
 							}
 						}
+						if (timing) {
+							secondary.write_timestamp(timing->end, PipelineStageFlagBits::eBottomOfPipe);
+						}
 						if (secondary.has_error()) {
 							return { expected_error, secondary.error() };
 						}
@@ -234,7 +253,7 @@ namespace vuk {
 						if (p->pass.execute) {
 							cobuf.current_pass = p;
 							if (!p->pass.name.is_invalid() && !is_single_pass) {
-								ctx.debug.begin_region(cobuf.command_buffer, p->pass.name);
+								ctx.debug.begin_region(cobuf.command_buffer, p->display_name);
 								p->pass.execute(cobuf);
 								ctx.debug.end_region(cobuf.command_buffer);
 							} else {
@@ -242,6 +261,9 @@ namespace vuk {
 							}
 						}
 					}
+					if (timestamps_in_primary) {
+						cobuf.write_timestamp(timing->end, PipelineStageFlagBits::eBottomOfPipe);
+					}
 					if (cobuf.has_error()) {
 						return { expected_error, cobuf.error() };
 					}
@@ -254,7 +276,7 @@ namespace vuk {
 				// insert image post-barriers
 				if (rpass.handle == VK_NULL_HANDLE) {
 					for (auto dep : sp.post_barriers) {
-						auto& bound = impl->bound_attachments[dep.image];
+						auto& bound = impl->bound_attachments.at(dep.image);
 						dep.barrier.image = bound.attachment.image;
 						// turn base_{layer, level} into absolute values wrt the image
 						dep.barrier.subresourceRange.baseArrayLayer += bound.attachment.base_layer;
@@ -273,7 +295,7 @@ namespace vuk {
 				vkCmdEndRenderPass(cbuf);
 			}
 			for (auto dep : rpass.post_barriers) {
-				auto& bound = impl->bound_attachments[dep.image];
+				auto& bound = impl->bound_attachments.at(dep.image);
 				dep.barrier.image = bound.attachment.image;
 				// turn base_{layer, level} into absolute values wrt the image
 				dep.barrier.subresourceRange.baseArrayLayer += bound.attachment.base_layer;
@@ -294,8 +316,22 @@ namespace vuk {
 		return { expected_value, std::move(si) };
 	}
 
+	// timestamp queries are only handed out by DeviceFrameResources, which may be behind other nested resources
+	static bool provides_timestamp_queries(DeviceResource* resource) {
+		while (auto nested = dynamic_cast<DeviceNestedResource*>(resource)) {
+			if (dynamic_cast<DeviceFrameResource*>(nested)) {
+				return true;
+			}
+			resource = nested->upstream;
+		}
+		return false;
+	}
+
 	Result<SubmitBundle> ExecutableRenderGraph::execute(Allocator& alloc, std::vector<std::pair<SwapchainRef, size_t>> swp_with_index) {
 		Context& ctx = alloc.get_context();
+		if (!impl->pass_timings.empty() && !provides_timestamp_queries(&alloc.get_device_resource())) {
+			return { expected_error, RenderGraphException{ "Timing passes requires executing with an Allocator backed by a DeviceFrameResource." } };
+		}
 		// bind swapchain attachment images & ivs
 		for (auto& [name, bound] : impl->bound_attachments) {
 			if (bound.type == AttachmentRPInfo::Type::eSwapchain) {
@@ -331,7 +367,7 @@ namespace vuk {
 
 				// see if any attachment has an absolute size
 				for (auto& attrpinfo : rp.attachments) {
-					auto& bound = impl->bound_attachments[attrpinfo.name];
+					auto& bound = impl->bound_attachments.at(attrpinfo.name);
 
 					if (bound.attachment.extent.sizing == vuk::Sizing::eAbsolute && bound.attachment.extent.extent.width > 0 &&
 					    bound.attachment.extent.extent.height > 0) {
@@ -346,7 +382,7 @@ namespace vuk {
 					rp.fbci.height = fb_extent.height;
 
 					for (auto& attrpinfo : rp.attachments) {
-						auto& bound = impl->bound_attachments[attrpinfo.name];
+						auto& bound = impl->bound_attachments.at(attrpinfo.name);
 						bound.attachment.extent = Dimension2D::absolute(fb_extent);
 					}
 
@@ -374,7 +410,7 @@ namespace vuk {
 			// create internal attachments; bind attachments to fb
 			for (auto& attrpinfo : rp.attachments) {
 				auto resolved_name = impl->resolve_name(attrpinfo.name);
-				auto& bound = impl->bound_attachments[resolved_name];
+				auto& bound = impl->bound_attachments.at(resolved_name);
 				if (bound.type == AttachmentRPInfo::Type::eInternal) {
 					create_attachment(ctx, resolved_name, bound, fb_extent, (vuk::SampleCountFlagBits)attrpinfo.description.samples);
 				}
@@ -401,6 +437,17 @@ namespace vuk {
 			}
 		}
 
+		// bind the resource tables of passes - no more resources are attached from here on
+		// the tables point into the maps of bound resources, so these are only looked up with at() or find() while recording, never inserted into
+		for (auto& p : impl->passes) {
+			for (auto& rr : p.resolved_resources) {
+				auto att_it = impl->bound_attachments.find(rr.resolved);
+				rr.attachment = att_it == impl->bound_attachments.end() ? nullptr : &att_it->second;
+				auto buf_it = impl->bound_buffers.find(rr.resolved);
+				rr.buffer = buf_it == impl->bound_buffers.end() ? nullptr : &buf_it->second;
+			}
+		}
+
 		for (auto& [name, attachment_info] : impl->bound_attachments) {
 			if (attachment_info.attached_future) {
 				ImageAttachment att = attachment_info.attachment;
@@ -447,6 +494,12 @@ namespace vuk {
 	}
 
 	Result<BufferInfo, RenderGraphException> ExecutableRenderGraph::get_resource_buffer(Name n, PassInfo* pass_info) {
+		if (auto rr = pass_info->find_resolved_resource(n)) {
+			if (!rr->buffer) {
+				return { expected_error, RenderGraphException{ "Buffer not found" } };
+			}
+			return { expected_value, *rr->buffer };
+		}
 		auto resolved = resolve_name(n, pass_info);
 		auto it = impl->bound_buffers.find(resolved);
 		if (it == impl->bound_buffers.end()) {
@@ -456,6 +509,12 @@ namespace vuk {
 	}
 
 	Result<AttachmentRPInfo, RenderGraphException> ExecutableRenderGraph::get_resource_image(Name n, PassInfo* pass_info) {
+		if (auto rr = pass_info->find_resolved_resource(n)) {
+			if (!rr->attachment) {
+				return { expected_error, RenderGraphException{ "Image not found" } };
+			}
+			return { expected_value, *rr->attachment };
+		}
 		auto resolved = resolve_name(n, pass_info);
 		auto it = impl->bound_attachments.find(resolved);
 		if (it == impl->bound_attachments.end()) {
@@ -465,6 +524,9 @@ namespace vuk {
 	}
 
 	Result<bool, RenderGraphException> ExecutableRenderGraph::is_resource_image_in_general_layout(Name n, PassInfo* pass_info) {
+		if (auto rr = pass_info->find_resolved_resource(n); rr && rr->layout_known) {
+			return { expected_value, rr->is_general_layout };
+		}
 		auto resolved = resolve_name(n, pass_info);
 		auto it = impl->use_chains.find(resolved);
 		if (it == impl->use_chains.end()) {
@@ -480,7 +542,14 @@ namespace vuk {
 		return { expected_error, RenderGraphException{ "Image resourced was not declared to be used in this pass, but was referred to." } };
 	}
 
+	std::span<const PassTiming> ExecutableRenderGraph::get_pass_timings() const {
+		return impl->pass_timings;
+	}
+
 	Name ExecutableRenderGraph::resolve_name(Name name, PassInfo* pass_info) const noexcept {
+		if (auto rr = pass_info->find_resolved_resource(name)) {
+			return rr->resolved;
+		}
 		auto qualified_name = pass_info->prefix.is_invalid() ? name : pass_info->prefix.append(name);
 		return impl->resolve_name(qualified_name);
 	}
@@ -20,7 +20,9 @@ namespace vuk {
 			for (auto& ub : set.uniform_buffers) {
 				VkDescriptorSetLayoutBinding layoutBinding;
 				layoutBinding.binding = ub.binding;
-				layoutBinding.descriptorType = (VkDescriptorType)vuk::DescriptorType::eUniformBuffer;
+				layoutBinding.descriptorType = (VkDescriptorType)(bci.dynamic_buffer_bindings.test(index * VUK_MAX_BINDINGS + ub.binding)
+				                                                      ? vuk::DescriptorType::eUniformBufferDynamic
+				                                                      : vuk::DescriptorType::eUniformBuffer);
 				layoutBinding.descriptorCount = 1;
 				layoutBinding.stageFlags = ub.stage;
 				layoutBinding.pImmutableSamplers = nullptr;
@@ -30,7 +32,9 @@ namespace vuk {
 			for (auto& sb : set.storage_buffers) {
 				VkDescriptorSetLayoutBinding layoutBinding;
 				layoutBinding.binding = sb.binding;
-				layoutBinding.descriptorType = (VkDescriptorType)vuk::DescriptorType::eStorageBuffer;
+				layoutBinding.descriptorType = (VkDescriptorType)(bci.dynamic_buffer_bindings.test(index * VUK_MAX_BINDINGS + sb.binding)
+				                                                      ? vuk::DescriptorType::eStorageBufferDynamic
+				                                                      : vuk::DescriptorType::eStorageBuffer);
 				layoutBinding.descriptorCount = 1;
 				layoutBinding.stageFlags = sb.stage;
 				layoutBinding.pImmutableSamplers = nullptr;
@@ -4,6 +4,7 @@
 #include "vuk/Context.hpp"
 #include "vuk/Exception.hpp"
 #include "vuk/Future.hpp"
+#include "vuk/Tracing.hpp"
 
 #include <set>
 #include <unordered_set>
@@ -69,6 +70,9 @@ namespace vuk {
 		for (auto& [name, buf] : other.impl->bound_buffers) {
 			impl->bound_buffers.emplace(joiner.append(name), std::move(buf));
 		}
+		for (auto& [new_name, old_name] : other.impl->aliases) {
+			impl->aliases.emplace(joiner.append(new_name), joiner.append(old_name));
+		}
 	}
 
 	void RenderGraph::add_alias(Name new_name, Name old_name) {
@@ -90,6 +94,7 @@ namespace vuk {
 
 	// determine rendergraph inputs and outputs, and resources that are neither
 	void RenderGraph::build_io() {
+		VUK_TRACE_SCOPE("RenderGraph::build_io");
 		for (auto& pif : impl->passes) {
 			for (Resource& res : pif.pass.resources) {
 				Name in_name;
@@ -210,6 +215,8 @@ namespace vuk {
 	}
 
 	void RenderGraph::compile(const RenderGraph::CompileOptions& compile_options) {
+		VUK_TRACE_SCOPE("RenderGraph::compile");
+		impl->flatten_aliases();
 		// find which reads are graph inputs (not produced by any pass) & outputs
 		// (not consumed by any pass)
 		build_io();
@@ -597,6 +604,7 @@ namespace vuk {
 	}
 
 	ExecutableRenderGraph RenderGraph::link(Context& ctx, const RenderGraph::CompileOptions& compile_options) && {
+		VUK_TRACE_SCOPE("RenderGraph::link");
 		compile(compile_options);
 
 		// at this point the graph is built, we know of all the resources and
@@ -797,7 +805,10 @@ namespace vuk {
 					// we are acquiring from a future
 					auto wait_fut = left.pass->pass.wait.get();
 					if (wait_fut) {
-						left.pass->absolute_waits.emplace_back(wait_fut->initial_domain, wait_fut->initial_visibility);
+						// results available on the host need no waiting
+						if (wait_fut->status == FutureBase::Status::eSubmitted) {
+							left.pass->absolute_waits.emplace_back(wait_fut->initial_domain, wait_fut->initial_visibility);
+						}
 
 						left_domain = wait_fut->initial_domain;
 						src_stages = wait_fut->last_use.stages;
@@ -1160,6 +1171,14 @@ namespace vuk {
 					fut.get_result<Buffer>() = buffer_info.buffer; // TODO: when we have managed buffers, then this is too soon to attach
 				}
 
+				// acquire from a submitted future - must be first in chain
+				if (is_acquire(right.original) && right.pass && right.pass->pass.wait) {
+					auto wait_fut = right.pass->pass.wait.get();
+					if (wait_fut->status == FutureBase::Status::eSubmitted) {
+						right.pass->absolute_waits.emplace_back(wait_fut->initial_domain, wait_fut->initial_visibility);
+					}
+				}
+
 				bool crosses_queue = (left_domain != DomainFlagBits::eNone && right_domain != DomainFlagBits::eNone &&
 				                      (left_domain & DomainFlagBits::eQueueMask) != (right_domain & DomainFlagBits::eQueueMask));
 				if (crosses_queue) {
@@ -1457,6 +1476,57 @@ namespace vuk {
 			rp.handle = ctx.acquire_renderpass(rp.rpci, ctx.get_frame_count());
 		}
 
+		for (auto& p : impl->passes) {
+			auto name = p.pass.name.to_sv();
+			auto separator = name.find("::");
+			bool fused = name.starts_with(fused_graph_prefix) && separator != std::string_view::npos;
+			p.display_name = fused ? Name(name.substr(separator + 2)) : p.pass.name;
+		}
+
+		if (compile_options.time_passes) {
+			for (auto& p : impl->passes) {
+				if (p.pass.name.is_invalid() || !p.pass.execute) {
+					continue;
+				}
+				// passes recording their own secondary command buffers in a render pass can't be timed: the primary command buffer only executes
+				// secondary command buffers in such a subpass
+				auto& rp = impl->rpis[p.render_pass_index];
+				if (p.pass.use_secondary_command_buffers && rp.handle != VK_NULL_HANDLE && rp.subpasses[p.subpass].use_secondary_command_buffers) {
+					continue;
+				}
+				p.timing_index = impl->pass_timings.size();
+				impl->pass_timings.emplace_back(PassTiming{ p.display_name, ctx.create_timestamp_query(), ctx.create_timestamp_query() });
+			}
+		}
+
+		// build the tables used for looking up resources while recording
+		for (auto& p : impl->passes) {
+			auto prefix_size = p.prefix.is_invalid() ? 0 : p.prefix.to_sv().size();
+			p.resolved_resources.clear();
+			p.resolved_resources.reserve(p.pass.resources.size());
+			for (auto& res : p.pass.resources) {
+				auto& rr = p.resolved_resources.emplace_back();
+				rr.name = prefix_size == 0 ? res.name : Name(res.name.to_sv().substr(prefix_size));
+				rr.resolved = impl->resolve_name(res.name);
+				if (res.type != Resource::Type::eImage) {
+					continue;
+				}
+				auto chain_it = impl->use_chains.find(rr.resolved);
+				if (chain_it == impl->use_chains.end()) {
+					continue;
+				}
+				for (auto& elem : chain_it->second) {
+					if (elem.pass == &p) {
+						rr.layout_known = true;
+						rr.is_general_layout = elem.use.layout == vuk::ImageLayout::eGeneral;
+						break;
+					}
+				}
+			}
+			// sorted by name for lookup - stable, so that the first declaration of a resource is found
+			std::stable_sort(p.resolved_resources.begin(), p.resolved_resources.end(), [](auto& a, auto& b) { return a.name < b.name; });
+		}
+
 		return { std::move(*this) };
 	}
 
@@ -42,15 +42,26 @@ namespace vuk {
 		robin_hood::unordered_flat_map<Name, AttachmentRPInfo> bound_attachments;
 		robin_hood::unordered_flat_map<Name, BufferInfo> bound_buffers;
 
+		std::vector<PassTiming> pass_timings;
+
 		RGImpl() : arena_(new arena(1024 * 1024)), INIT(passes), INIT(ordered_passes), INIT(rpis) {}
 
-		Name resolve_name(Name in) {
-			auto it = aliases.find(in);
-			if (it == aliases.end())
-				return in;
-			else
-				return resolve_name(it->second);
+		// read-only, so that it can be called concurrently while recording - chains are a single hop once flatten_aliases() ran
+		Name resolve_name(Name in) const {
+			Name root = in;
+			for (auto it = aliases.find(root); it != aliases.end(); it = aliases.find(root)) {
+				root = it->second;
+			}
+			return root;
 		};
+
+		// point every alias directly at the end of its chain
+		// called once when compiling, as no aliases are added afterwards
+		void flatten_aliases() {
+			for (auto& [name, target] : aliases) {
+				target = resolve_name(target);
+			}
+		}
 	};
 #undef INIT
 
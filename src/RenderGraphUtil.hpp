@@ -3,6 +3,8 @@
 #include "vuk/RenderGraph.hpp"
 #include "vuk/ShortAlloc.hpp"
 
+#include <algorithm>
+
 namespace std {
 	template<>
 	struct hash<vuk::Resource> {
@@ -283,6 +285,9 @@ namespace vuk {
 		PassInfo* pass = nullptr;
 	};
 
+	// subgraph name prefix given to the graphs fused for a single submission, not shown to the user
+	inline constexpr std::string_view fused_graph_prefix = "_FUSED";
+
 	struct PassInfo {
 		PassInfo(arena&, Pass&&);
 
@@ -293,6 +298,8 @@ namespace vuk {
 		DomainFlags domain;
 
 		Name prefix;
+		// name shown in debug labels and timings - the pass name without the prefix added when fusing graphs
+		Name display_name;
 
 		std::vector<std::pair<DomainFlagBits, PassInfo*>> waits;
 		std::vector<std::pair<DomainFlagBits, uint64_t>> absolute_waits;
@@ -308,6 +315,25 @@ namespace vuk {
 
 		bool is_head_pass = false;
 		bool is_tail_pass = false;
+
+		// index into RGImpl::pass_timings, if this pass is timed
+		std::optional<size_t> timing_index;
+
+		// resources declared by this pass, resolved when linking, so that recording can look them up without resolving names
+		struct ResolvedResource {
+			Name name;     // name as referred to from the pass, without the prefix
+			Name resolved; // qualified name with aliases resolved
+			bool layout_known = false;
+			bool is_general_layout = false;
+			struct AttachmentRPInfo* attachment = nullptr; // bound when executing
+			struct BufferInfo* buffer = nullptr;           // bound when executing
+		};
+		std::vector<ResolvedResource> resolved_resources; // sorted by name
+
+		ResolvedResource* find_resolved_resource(Name name) {
+			auto it = std::lower_bound(resolved_resources.begin(), resolved_resources.end(), name, [](auto& r, Name n) { return r.name < n; });
+			return it != resolved_resources.end() && it->name == name ? &*it : nullptr;
+		}
 	};
 
 	struct AttachmentSInfo {
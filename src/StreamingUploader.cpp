@@ -0,0 +1,338 @@
+#include "vuk/StreamingUploader.hpp"
+#include "vuk/AllocatorHelpers.hpp"
+#include "vuk/CommandBuffer.hpp"
+#include "vuk/Context.hpp"
+#include "vuk/Tracing.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string.h>
+#include <vector>
+
+namespace vuk {
+	struct StreamingUploaderImpl {
+		Context& ctx;
+		Unique<BufferCrossDevice> staging;
+		size_t capacity;
+
+		std::mutex mutex;
+
+		// absolute byte positions in the ring - [tail, head) is in use by pending or in-flight uploads
+		uint64_t head = 0;
+		uint64_t tail = 0;
+
+		// submitted uploads, with the end of their staging memory and the transfer queue timeline value they complete at
+		struct InFlight {
+			uint64_t end;
+			uint64_t value;
+		};
+		std::deque<InFlight> in_flight;
+
+		struct PendingBufferCopy {
+			Buffer dst;
+			VkBufferCopy region;
+			std::shared_ptr<FutureBase> future;
+		};
+		std::vector<PendingBufferCopy> buffer_copies;
+
+		struct PendingImageCopy {
+			ImageAttachment dst;
+			BufferImageCopy region;
+			uint32_t dst_queue_family_index;
+			std::shared_ptr<FutureBase> future;
+		};
+		std::vector<PendingImageCopy> image_copies;
+
+		StreamingUploaderImpl(Allocator& allocator, size_t capacity) :
+		    ctx(allocator.get_context()),
+		    staging(*allocate_buffer_cross_device(allocator, BufferCreateInfo{ MemoryUsage::eCPUonly, capacity, 16 })),
+		    capacity(capacity) {}
+
+		// returns the offset in the staging buffer
+		std::optional<size_t> try_allocate(size_t size, size_t alignment) {
+			auto offset = head % capacity;
+			auto aligned_offset = (offset + alignment - 1) / alignment * alignment;
+			auto start = head + (aligned_offset - offset);
+			// allocations don't straddle the end of the ring
+			if (aligned_offset + size > capacity) {
+				start = head + (capacity - offset);
+			}
+			if (start + size - tail > capacity) {
+				return {};
+			}
+			head = start + size;
+			return start % capacity;
+		}
+
+		uint64_t collect() {
+			auto& submit_sync = ctx.transfer_queue->get_submit_sync();
+			uint64_t completed = 0;
+			vkGetSemaphoreCounterValue(ctx.device, submit_sync.semaphore, &completed);
+			while (!in_flight.empty() && in_flight.front().value <= completed) {
+				tail = in_flight.front().end;
+				in_flight.pop_front();
+			}
+			return completed;
+		}
+
+		// block until the oldest in-flight upload completes
+		Result<void> wait_oldest() {
+			auto& submit_sync = ctx.transfer_queue->get_submit_sync();
+			VkSemaphoreWaitInfo swi{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+			swi.semaphoreCount = 1;
+			swi.pSemaphores = &submit_sync.semaphore;
+			swi.pValues = &in_flight.front().value;
+			VkResult result = vkWaitSemaphores(ctx.device, &swi, UINT64_MAX);
+			if (result != VK_SUCCESS) {
+				return { expected_error, VkException{ result } };
+			}
+			tail = in_flight.front().end;
+			in_flight.pop_front();
+			return { expected_value };
+		}
+
+		// copies the data into the staging buffer, submitting and waiting for earlier uploads if it is full
+		Result<size_t> stage(Allocator& allocator, const void* src_data, size_t size, size_t alignment) {
+			if (size > capacity) {
+				return { expected_error, AllocateException{ VK_ERROR_OUT_OF_DEVICE_MEMORY } };
+			}
+			auto offset = try_allocate(size, alignment);
+			if (!offset) {
+				collect();
+				offset = try_allocate(size, alignment);
+			}
+			if (!offset && (buffer_copies.size() > 0 || image_copies.size() > 0)) {
+				VUK_DO_OR_RETURN(flush(allocator));
+			}
+			while (!offset && !in_flight.empty()) {
+				VUK_DO_OR_RETURN(wait_oldest());
+				offset = try_allocate(size, alignment);
+			}
+			if (!offset) {
+				// nothing in flight, the staging buffer is empty
+				head = tail = 0;
+				offset = try_allocate(size, alignment);
+			}
+			::memcpy(staging->mapped_ptr + *offset, src_data, size);
+			return { expected_value, *offset };
+		}
+
+		Result<void> flush(Allocator& allocator) {
+			VUK_TRACE_SCOPE("StreamingUploader::flush");
+			if (buffer_copies.empty() && image_copies.empty()) {
+				return { expected_value };
+			}
+
+			Queue& queue = *ctx.transfer_queue;
+			VkCommandPoolCreateInfo cpci{ .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+			cpci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			cpci.queueFamilyIndex = ctx.transfer_queue_family_index;
+			auto pool = allocate_command_pool(allocator, cpci);
+			if (!pool) {
+				return { expected_error, pool.error() };
+			}
+			auto cbuf = allocate_command_buffer(allocator, { VK_COMMAND_BUFFER_LEVEL_PRIMARY, **pool });
+			if (!cbuf) {
+				return { expected_error, cbuf.error() };
+			}
+			auto fence = allocate_fence(allocator);
+			if (!fence) {
+				return { expected_error, fence.error() };
+			}
+			VkCommandBuffer command_buffer = (*cbuf)->command_buffer;
+
+			VkCommandBufferBeginInfo cbi{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
+			vkBeginCommandBuffer(command_buffer, &cbi);
+
+			// copies into the same buffer are issued together
+			std::stable_sort(buffer_copies.begin(), buffer_copies.end(), [](auto& a, auto& b) { return a.dst.buffer < b.dst.buffer; });
+			std::vector<VkBufferCopy> regions;
+			for (size_t i = 0; i < buffer_copies.size();) {
+				regions.clear();
+				auto dst = buffer_copies[i].dst.buffer;
+				for (; i < buffer_copies.size() && buffer_copies[i].dst.buffer == dst; i++) {
+					regions.push_back(buffer_copies[i].region);
+				}
+				vkCmdCopyBuffer(command_buffer, staging->buffer, dst, (uint32_t)regions.size(), regions.data());
+			}
+
+			if (image_copies.size() > 0) {
+				std::vector<VkImageMemoryBarrier> barriers;
+				barriers.reserve(image_copies.size());
+				for (auto& c : image_copies) {
+					VkImageMemoryBarrier barrier{ .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+					barrier.srcAccessMask = 0;
+					barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.image = c.dst.image;
+					// the whole image is transitioned, so that the levels and layers not uploaded are also in the layout the RenderGraph expects
+					barrier.subresourceRange = { (VkImageAspectFlags)c.region.imageSubresource.aspectMask, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+					barriers.push_back(barrier);
+				}
+				vkCmdPipelineBarrier(command_buffer,
+				                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+				                     0,
+				                     0,
+				                     nullptr,
+				                     0,
+				                     nullptr,
+				                     (uint32_t)barriers.size(),
+				                     barriers.data());
+				for (auto& c : image_copies) {
+					const VkBufferImageCopy& region = c.region;
+					vkCmdCopyBufferToImage(command_buffer, staging->buffer, c.dst.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+				}
+
+				// release half of the queue family ownership transfer, the acquire is performed by the RenderGraph using the image
+				barriers.clear();
+				for (size_t i = 0; i < image_copies.size(); i++) {
+					auto& c = image_copies[i];
+					if (c.dst_queue_family_index == ctx.transfer_queue_family_index) {
+						continue;
+					}
+					VkImageMemoryBarrier barrier{ .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+					barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					barrier.dstAccessMask = 0;
+					barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					barrier.srcQueueFamilyIndex = ctx.transfer_queue_family_index;
+					barrier.dstQueueFamilyIndex = c.dst_queue_family_index;
+					barrier.image = c.dst.image;
+					// the RenderGraph acquires the whole image, so the release covers the whole image as well
+					barrier.subresourceRange = { (VkImageAspectFlags)c.region.imageSubresource.aspectMask, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+					barriers.push_back(barrier);
+				}
+				if (barriers.size() > 0) {
+					vkCmdPipelineBarrier(command_buffer,
+					                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+					                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+					                     0,
+					                     0,
+					                     nullptr,
+					                     0,
+					                     nullptr,
+					                     (uint32_t)barriers.size(),
+					                     barriers.data());
+				}
+			}
+
+			if (VkResult result = vkEndCommandBuffer(command_buffer); result != VK_SUCCESS) {
+				return { expected_error, VkException{ result } };
+			}
+
+			uint64_t signal_value;
+			{
+				std::lock_guard _(queue.get_queue_lock());
+				auto& submit_sync = queue.get_submit_sync();
+				signal_value = ++(*submit_sync.value);
+
+				VkCommandBufferSubmitInfoKHR cbsi{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR, .commandBuffer = command_buffer };
+				VkSemaphoreSubmitInfoKHR ssi{ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR };
+				ssi.semaphore = submit_sync.semaphore;
+				ssi.value = signal_value;
+				ssi.stageMask = (VkPipelineStageFlagBits2KHR)PipelineStageFlagBits::eAllCommands;
+				VkSubmitInfo2KHR si{ VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR };
+				si.commandBufferInfoCount = 1;
+				si.pCommandBufferInfos = &cbsi;
+				si.signalSemaphoreInfoCount = 1;
+				si.pSignalSemaphoreInfos = &ssi;
+				VUK_DO_OR_RETURN(queue.submit(std::span{ &si, 1 }, **fence));
+			}
+
+			auto signal_future = [&](const std::shared_ptr<FutureBase>& future, ImageLayout layout) {
+				future->status = FutureBase::Status::eSubmitted;
+				future->initial_domain = DomainFlagBits::eTransferQueue;
+				future->initial_visibility = signal_value;
+				future->last_use =
+				    QueueResourceUse{ eTransferWrite, PipelineStageFlagBits::eTransfer, AccessFlagBits::eTransferWrite, layout, DomainFlagBits::eTransferQueue };
+			};
+			for (auto& c : buffer_copies) {
+				signal_future(c.future, ImageLayout::eUndefined);
+			}
+			for (auto& c : image_copies) {
+				signal_future(c.future, ImageLayout::eTransferDstOptimal);
+			}
+			buffer_copies.clear();
+			image_copies.clear();
+			in_flight.push_back({ head, signal_value });
+
+			return { expected_value };
+		}
+	};
+
+	StreamingUploader::StreamingUploader(Allocator& allocator, size_t staging_size) : impl(new StreamingUploaderImpl(allocator, staging_size)) {}
+
+	StreamingUploader::~StreamingUploader() {
+		// the staging buffer must not be destroyed while transfers are reading from it
+		while (!impl->in_flight.empty()) {
+			if (!impl->wait_oldest()) {
+				break;
+			}
+		}
+		delete impl;
+	}
+
+	Result<Future<Buffer>> StreamingUploader::upload(Allocator& allocator, Buffer dst, const void* src_data, size_t size) {
+		// host-mapped buffers just get memcpys
+		if (dst.mapped_ptr) {
+			::memcpy(dst.mapped_ptr, src_data, size);
+			return { expected_value, Future<Buffer>{ allocator, std::move(dst) } };
+		}
+
+		std::scoped_lock _(impl->mutex);
+		auto offset = impl->stage(allocator, src_data, size, 4);
+		if (!offset) {
+			return { expected_error, offset.error() };
+		}
+		VkBufferCopy region{ .srcOffset = impl->staging->offset + *offset, .dstOffset = dst.offset, .size = size };
+		Future<Buffer> future{ allocator, Buffer{ dst } };
+		future.get_status() = FutureBase::Status::eInitial; // not submitted yet
+		impl->buffer_copies.push_back({ dst, region, future.control });
+		return { expected_value, std::move(future) };
+	}
+
+	Result<Future<ImageAttachment>> StreamingUploader::upload(Allocator& allocator, ImageAttachment dst, const void* src_data, DomainFlagBits dst_domain) {
+		assert(dst.extent.sizing == Sizing::eAbsolute);
+		auto extent = static_cast<Extent3D>(dst.extent.extent);
+		uint32_t layer_count = dst.layer_count == VK_REMAINING_ARRAY_LAYERS ? 1 : dst.layer_count;
+		size_t size = (size_t)compute_image_size(dst.format, extent) * layer_count;
+		// buffer offsets of image copies must be a multiple of both the texel block size and 4
+		size_t alignment = std::lcm((size_t)format_to_texel_block_size(dst.format), (size_t)4);
+
+		std::scoped_lock _(impl->mutex);
+		auto offset = impl->stage(allocator, src_data, size, alignment);
+		if (!offset) {
+			return { expected_error, offset.error() };
+		}
+		BufferImageCopy bc;
+		bc.bufferOffset = impl->staging->offset + *offset;
+		bc.imageOffset = { 0, 0, 0 };
+		bc.imageExtent = extent;
+		bc.imageSubresource.aspectMask = format_to_aspect(dst.format);
+		bc.imageSubresource.mipLevel = dst.base_level;
+		bc.imageSubresource.baseArrayLayer = dst.base_layer;
+		bc.imageSubresource.layerCount = layer_count;
+
+		Future<ImageAttachment> future{ allocator, ImageAttachment{ dst } };
+		future.get_status() = FutureBase::Status::eInitial; // not submitted yet
+		impl->image_copies.push_back({ dst, bc, impl->ctx.domain_to_queue_family_index(dst_domain), future.control });
+		return { expected_value, std::move(future) };
+	}
+
+	Result<void> StreamingUploader::flush(Allocator& allocator) {
+		std::scoped_lock _(impl->mutex);
+		return impl->flush(allocator);
+	}
+
+	uint64_t StreamingUploader::collect() {
+		std::scoped_lock _(impl->mutex);
+		return impl->collect();
+	}
+} // namespace vuk
@@ -0,0 +1,123 @@
+#include "vuk/Tracing.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+	struct TraceEvent {
+		const char* name;
+		uint64_t start;
+		uint64_t duration;
+	};
+
+	// events of a single thread - owned by the registry, so that they outlive the thread
+	struct ThreadTrace {
+		uint64_t thread_index;
+		std::mutex mutex; // only contended while exporting or clearing
+		std::vector<TraceEvent> events;
+	};
+
+	struct TraceRegistry {
+		std::atomic<bool> enabled = false;
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadTrace>> threads;
+
+		ThreadTrace* register_thread() {
+			std::scoped_lock _(mutex);
+			auto& t = threads.emplace_back(std::make_unique<ThreadTrace>());
+			t->thread_index = threads.size() - 1;
+			return t.get();
+		}
+	};
+
+	TraceRegistry& get_registry() {
+		static TraceRegistry registry;
+		return registry;
+	}
+
+	ThreadTrace& get_thread_trace() {
+		static thread_local ThreadTrace* trace = get_registry().register_thread();
+		return *trace;
+	}
+
+	uint64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void append_escaped(std::string& out, const char* s) {
+		for (; *s; s++) {
+			if (*s == '"' || *s == '\\') {
+				out += '\\';
+			}
+			out += *s;
+		}
+	}
+} // namespace
+
+namespace vuk {
+	void set_tracing_enabled(bool enabled) {
+		get_registry().enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	bool is_tracing_enabled() {
+		return get_registry().enabled.load(std::memory_order_relaxed);
+	}
+
+	void clear_trace() {
+		auto& registry = get_registry();
+		std::scoped_lock _(registry.mutex);
+		for (auto& t : registry.threads) {
+			std::scoped_lock _(t->mutex);
+			t->events.clear();
+		}
+	}
+
+	std::string export_chrome_trace() {
+		auto& registry = get_registry();
+		std::string out = "{\"traceEvents\":[";
+		bool first = true;
+		std::scoped_lock _(registry.mutex);
+		for (auto& t : registry.threads) {
+			std::scoped_lock _(t->mutex);
+			for (auto& e : t->events) {
+				if (!first) {
+					out += ',';
+				}
+				first = false;
+				// timestamps and durations are in microseconds
+				out += "{\"name\":\"";
+				append_escaped(out, e.name);
+				out += "\",\"cat\":\"vuk\",\"ph\":\"X\",\"pid\":0,\"tid\":";
+				out += std::to_string(t->thread_index);
+				out += ",\"ts\":";
+				out += std::to_string(e.start / 1000.0);
+				out += ",\"dur\":";
+				out += std::to_string(e.duration / 1000.0);
+				out += '}';
+			}
+		}
+		out += "],\"displayTimeUnit\":\"ns\"}";
+		return out;
+	}
+
+	TraceScope::TraceScope(const char* name) noexcept : name(name), start(0) {
+		if (is_tracing_enabled()) {
+			start = now();
+		}
+	}
+
+	TraceScope::~TraceScope() {
+		// tracing was disabled when the scope was entered
+		if (start == 0) {
+			return;
+		}
+		auto end = now();
+		auto& trace = get_thread_trace();
+		std::scoped_lock _(trace.mutex);
+		trace.events.push_back(TraceEvent{ name, start, end - start });
+	}
+} // namespace vuk
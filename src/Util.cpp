@@ -1,11 +1,14 @@
+#include "RenderGraphUtil.hpp"
 #include "vuk/AllocatorHelpers.hpp"
 #include "vuk/Context.hpp"
 #include "vuk/Future.hpp"
 #include "vuk/RenderGraph.hpp"
 #include "vuk/SampledImage.hpp"
 
-#include <mutex>
+#include <algorithm>
 #include <atomic>
+#include <mutex>
+#include <string>
 
 namespace vuk {
 	struct QueueImpl {
@@ -89,11 +92,30 @@ namespace vuk {
 	}
 
 	Result<void> link_execute_submit(Allocator& allocator, std::span<std::pair<Allocator*, RenderGraph*>> rgs) {
+		// graphs sharing an allocator are fused into a single graph, so that they are compiled and linked once
+		std::vector<std::pair<Allocator*, std::vector<RenderGraph*>>> groups;
+		for (auto& [alloc, rg] : rgs) {
+			auto it = std::find_if(groups.begin(), groups.end(), [alloc = alloc](auto& g) { return g.first == alloc; });
+			auto& group = it == groups.end() ? groups.emplace_back(alloc, std::vector<RenderGraph*>{}).second : it->second;
+			if (std::find(group.begin(), group.end(), rg) == group.end()) {
+				group.push_back(rg);
+			}
+		}
+
 		std::vector<ExecutableRenderGraph> ergs;
 		std::vector<std::pair<Allocator*, ExecutableRenderGraph*>> ptrvec;
-		ergs.reserve(rgs.size());
-		for (auto& [alloc, rg] : rgs) {
-			ergs.emplace_back(std::move(*rg).link(alloc->get_context(), {}));
+		ergs.reserve(groups.size());
+		for (auto& [alloc, group] : groups) {
+			if (group.size() == 1) {
+				ergs.emplace_back(std::move(*group[0]).link(alloc->get_context(), {}));
+			} else {
+				RenderGraph fused;
+				for (size_t i = 0; i < group.size(); i++) {
+					auto prefix = std::string(fused_graph_prefix) + std::to_string(i);
+					fused.append(Name{ std::string_view(prefix) }, std::move(*group[i]));
+				}
+				ergs.emplace_back(std::move(fused).link(alloc->get_context(), {}));
+			}
 			ptrvec.emplace_back(alloc, &ergs.back());
 		}
 
@@ -174,7 +196,7 @@ namespace vuk {
 			for (uint64_t i = 0; i < batch.submits.size(); i++) {
 				SubmitInfo& submit_info = batch.submits[i];
 				num_cbufs += submit_info.command_buffers.size();
-				num_waits += submit_info.relative_waits.size();
+				num_waits += submit_info.relative_waits.size() + submit_info.absolute_waits.size();
 			}
 
 			std::vector<VkSubmitInfo2KHR> sis;
@@ -211,6 +233,15 @@ namespace vuk {
 					wait_semas.emplace_back(ssi);
 					wait_sema_count++;
 				}
+				// waits on values of other submissions (such as Futures that were already submitted)
+				for (auto& w : submit_info.absolute_waits) {
+					VkSemaphoreSubmitInfoKHR ssi{ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR };
+					ssi.semaphore = ctx.domain_to_queue(w.first).impl->submit_sync.semaphore;
+					ssi.value = w.second;
+					ssi.stageMask = (VkPipelineStageFlagBits2KHR)PipelineStageFlagBits::eAllCommands;
+					wait_semas.emplace_back(ssi);
+					wait_sema_count++;
+				}
 				if (domain == DomainFlagBits::eGraphicsQueue && i == 0 && present_rdy != VK_NULL_HANDLE) { // TODO: for first cbuf only that refs the swapchain attment
 					VkSemaphoreSubmitInfoKHR ssi{ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR };
 					ssi.semaphore = present_rdy;
@@ -358,7 +389,7 @@ namespace vuk {
 	Future<T>::Future(Allocator& alloc, struct RenderGraph& rg, Name output_binding, DomainFlags dst_domain) :
 	    output_binding(output_binding),
 	    rg(&rg),
-	    control(std::make_unique<FutureBase>(alloc)) {
+	    control(std::make_shared<FutureBase>(alloc)) {
 		control->status = FutureBase::Status::eRenderGraphBound;
 		this->rg->attach_out(output_binding, *this, dst_domain);
 	}
@@ -368,13 +399,13 @@ namespace vuk {
 	    output_binding(output_binding),
 	    owned_rg(std::move(org)),
 	    rg(owned_rg.get()),
-	    control(std::make_unique<FutureBase>(alloc)) {
+	    control(std::make_shared<FutureBase>(alloc)) {
 		control->status = FutureBase::Status::eRenderGraphBound;
 		rg->attach_out(output_binding, *this, dst_domain);
 	}
 
 	template<class T>
-	Future<T>::Future(Allocator& alloc, T&& value) : control(std::make_unique<FutureBase>(alloc)) {
+	Future<T>::Future(Allocator& alloc, T&& value) : control(std::make_shared<FutureBase>(alloc)) {
 		control->get_result<T>() = std::move(value);
 		control->status = FutureBase::Status::eHostAvailable;
 	}
@@ -400,6 +431,24 @@ namespace vuk {
 		}
 	}
 
+	template<class T>
+	bool Future<T>::poll() {
+		if (control->status == FutureBase::Status::eHostAvailable) {
+			return true;
+		} else if (control->status != FutureBase::Status::eSubmitted) {
+			return false;
+		}
+		auto& ctx = control->allocator->get_context();
+		auto& submit_sync = ctx.domain_to_queue(control->initial_domain).impl->submit_sync;
+		uint64_t value = 0;
+		if (vkGetSemaphoreCounterValue(ctx.device, submit_sync.semaphore, &value) != VK_SUCCESS || value < control->initial_visibility) {
+			return false;
+		}
+		ctx.domain_to_queue(control->initial_domain).impl->last_host_wait.store(value);
+		control->status = FutureBase::Status::eHostAvailable;
+		return true;
+	}
+
 	template<class T>
 	Result<void> Future<T>::submit() {
 		if (control->status == FutureBase::Status::eInputAttached || control->status == FutureBase::Status::eInitial) {